@@ -69,6 +69,7 @@ DO_LABEL(Default)
 	DO_LABEL(Substance)
 	DO_LABEL(Sprites)
 	DO_LABEL(ClusterRenderer)
+	DO_LABEL(FrameTemp)
 
 	// Editor Specific
 	DO_LABEL(EditorGui)
@@ -6,8 +6,12 @@
 #define ENABLE_MEM_PROFILER (ENABLE_MEMORY_MANAGER && ENABLE_PROFILER)
 #if ENABLE_MEM_PROFILER
 #define IF_MEMORY_PROFILER_ENABLED(x) x
+// learn the lifetime of allocations per allocation site, and let the MemoryManager
+// put the ones predicted to be short lived into separate pools
+#define SEGREGATE_SHORT_LIVED_ALLOCATIONS 0
 #else
 #define IF_MEMORY_PROFILER_ENABLED(x) 
+#define SEGREGATE_SHORT_LIVED_ALLOCATIONS 0
 #endif
 
 // Must be in Sync with ENUM WiiMemory in PlayerSettings.txt
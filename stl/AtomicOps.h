@@ -23,6 +23,21 @@ FORCE_INLINE bool AtomicCompareExchange (int volatile* i, int newValue, int expe
 // AtomicExchange - Returns the initial value pointed to by Target (as defined by _InterlockedExchange)
 FORCE_INLINE int AtomicExchange (int volatile* i, int value);
 
+// AtomicCompareExchange64 - Returns true if the value was exchanged. Also available on 32 bit platforms.
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue);
+
+// AtomicRead64 - Reads a 64 bit value without tearing, also on 32 bit platforms
+FORCE_INLINE UInt64 AtomicRead64 (UInt64 volatile* i);
+
+// AtomicMemoryBarrier - Full barrier, no load or store is moved across it by the compiler or the CPU
+FORCE_INLINE void AtomicMemoryBarrier ();
+
+// AtomicLoadAcquire - Reads the value, loads and stores after it are not moved before it
+FORCE_INLINE int AtomicLoadAcquire (int volatile* i);
+
+// AtomicStoreRelease - Writes the value, loads and stores before it are not moved after it
+FORCE_INLINE void AtomicStoreRelease (int volatile* i, int value);
+
 #define ATOMIC_API_GENERIC (UNITY_OSX || UNITY_IPHONE || UNITY_WIN || UNITY_XENON || UNITY_PS3 || UNITY_ANDROID || UNITY_PEPPER || UNITY_LINUX || UNITY_BB10 || UNITY_WII || UNITY_TIZEN)
 
 #if !ATOMIC_API_GENERIC && SUPPORT_THREADS
@@ -158,6 +173,24 @@ FORCE_INLINE bool AtomicCompareExchange (int volatile* i, int newValue, int expe
 FORCE_INLINE bool AtomicCompareExchange (int volatile* i, int newValue, int expectedValue) {
 	return cellAtomicCompareAndSwap32((uint32_t*)i, (uint32_t)expectedValue, (uint32_t)newValue) == (uint32_t)expectedValue;
 }
+#elif UNITY_WII
+FORCE_INLINE bool AtomicCompareExchange (int volatile* i, int newValue, int expectedValue) {
+	int wasEnabled = OSDisableInterrupts();
+	bool exchanged = *i == expectedValue;
+	if (exchanged)
+		*i = newValue;
+	OSRestoreInterrupts(wasEnabled);
+	return exchanged;
+}
+#elif !SUPPORT_THREADS
+FORCE_INLINE bool AtomicCompareExchange (int volatile* i, int newValue, int expectedValue) {
+	if (*i != expectedValue)
+		return false;
+	*i = newValue;
+	return true;
+}
+#else
+#error "Atomic op undefined for this platform"
 #endif
 
 // AtomicExchange - Returns the initial value pointed to by Target (as defined by _InterlockedExchange)
@@ -174,6 +207,104 @@ FORCE_INLINE int AtomicExchange (int volatile* i, int value) {
 }
 #endif
 
+// AtomicCompareExchange64 - Returns true if the value was exchanged. Also available on 32 bit platforms.
+#if UNITY_WIN || UNITY_XENON
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue) {
+	return _InterlockedCompareExchange64 ((__int64 volatile*)i, (__int64)newValue, (__int64)expectedValue) == (__int64)expectedValue;
+}
+#elif UNITY_OSX || UNITY_IPHONE
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue) {
+	return OSAtomicCompareAndSwap64Barrier (expectedValue, newValue, reinterpret_cast<volatile int64_t*>(i));
+}
+#elif UNITY_LINUX || UNITY_PEPPER || UNITY_ANDROID || UNITY_BB10 || UNITY_TIZEN
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue) {
+	return __sync_bool_compare_and_swap(i, expectedValue, newValue);
+}
+#elif UNITY_PS3
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue) {
+	return cellAtomicCompareAndSwap64((uint64_t*)i, (uint64_t)expectedValue, (uint64_t)newValue) == (uint64_t)expectedValue;
+}
+#elif UNITY_WII
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue) {
+	int wasEnabled = OSDisableInterrupts();
+	bool exchanged = *i == expectedValue;
+	if (exchanged)
+		*i = newValue;
+	OSRestoreInterrupts(wasEnabled);
+	return exchanged;
+}
+#elif !SUPPORT_THREADS
+FORCE_INLINE bool AtomicCompareExchange64 (UInt64 volatile* i, UInt64 newValue, UInt64 expectedValue) {
+	if (*i != expectedValue)
+		return false;
+	*i = newValue;
+	return true;
+}
+#else
+#error "Atomic op undefined for this platform"
+#endif
+
+// AtomicRead64 - Reads a 64 bit value without tearing, also on 32 bit platforms
+FORCE_INLINE UInt64 AtomicRead64 (UInt64 volatile* i) {
+#if UNITY_64 || UNITY_XENON || UNITY_PS3 || !SUPPORT_THREADS
+	return *i;
+#else
+	// a torn read can't compare equal to memory, so the exchange only succeeds for a consistent value
+	UInt64 value;
+	do { value = *i; }
+	while (!AtomicCompareExchange64(i, value, value));
+	return value;
+#endif
+}
+
+// AtomicMemoryBarrier - Full barrier, no load or store is moved across it by the compiler or the CPU
+FORCE_INLINE void AtomicMemoryBarrier () {
+#if UNITY_WIN
+	_ReadWriteBarrier ();
+	_mm_mfence ();
+#elif UNITY_XENON
+	__sync ();
+#elif UNITY_PS3
+	__asm__ __volatile__ ("sync" : : : "memory");
+#elif UNITY_OSX || UNITY_IPHONE
+	OSMemoryBarrier ();
+#elif UNITY_LINUX || UNITY_PEPPER || UNITY_ANDROID || UNITY_BB10 || UNITY_TIZEN
+	__sync_synchronize ();
+#elif UNITY_WII
+	__sync ();
+#elif !SUPPORT_THREADS
+	// nothing runs concurrently
+#else
+#error "Atomic op undefined for this platform"
+#endif
+}
+
+// x86 CPUs don't reorder loads with loads or stores with stores, acquire and release only have to stop the compiler
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#	if defined(_MSC_VER)
+#		define ATOMIC_ACQUIRE_RELEASE_BARRIER() _ReadWriteBarrier ()
+#	else
+#		define ATOMIC_ACQUIRE_RELEASE_BARRIER() __asm__ __volatile__ ("" : : : "memory")
+#	endif
+#else
+#	define ATOMIC_ACQUIRE_RELEASE_BARRIER() AtomicMemoryBarrier ()
+#endif
+
+// AtomicLoadAcquire - Reads the value, loads and stores after it are not moved before it
+FORCE_INLINE int AtomicLoadAcquire (int volatile* i) {
+	int value = *i;
+	ATOMIC_ACQUIRE_RELEASE_BARRIER ();
+	return value;
+}
+
+// AtomicStoreRelease - Writes the value, loads and stores before it are not moved after it
+FORCE_INLINE void AtomicStoreRelease (int volatile* i, int value) {
+	ATOMIC_ACQUIRE_RELEASE_BARRIER ();
+	*i = value;
+}
+
+#undef ATOMIC_ACQUIRE_RELEASE_BARRIER
+
 #endif // ATOMIC_API_GENERIC
 #undef ATOMIC_API_GENERIC
 
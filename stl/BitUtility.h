@@ -2,6 +2,9 @@
 #define BITUTILITY_H
 
 #include <limits.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 // index of the most significant bit in the mask
 
@@ -128,6 +131,76 @@ inline int BitsInMask64 (UInt64 v)
 	return (UInt64)(v * ((UInt64)~(UInt64)0/255)) >> (sizeof(UInt64) - 1) * CHAR_BIT;
 }
 
+// HighestBit64, LowestBit64, PopCount and PopCount64 use the CPU's bit scan / count leading zeros and
+// population count instructions where the compiler exposes them, and the functions above otherwise.
+// HighestBit and LowestBit keep the lookup tables, they also work on compilers without intrinsics.
+
+// index of the most significant bit in the 64 bit mask, -1 if the mask is 0
+inline int HighestBit64(UInt64 mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	return _BitScanReverse64(&index, mask) ? (int)index : -1;
+#elif defined(_MSC_VER) && defined(_M_IX86)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(mask >> 32)))
+		return (int)index + 32;
+	return _BitScanReverse(&index, (unsigned long)mask) ? (int)index : -1;
+#elif defined(__GNUC__)
+	return mask != 0 ? 63 - __builtin_clzll(mask) : -1;
+#else
+	if (mask >> 32)
+		return HighestBit((UInt32)(mask >> 32)) + 32;
+	return mask != 0 ? HighestBit((UInt32)mask) : -1;
+#endif
+}
+
+// index of the least significant bit in the 64 bit mask, -1 if the mask is 0
+inline int LowestBit64(UInt64 mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	return _BitScanForward64(&index, mask) ? (int)index : -1;
+#elif defined(_MSC_VER) && defined(_M_IX86)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)mask))
+		return (int)index;
+	return _BitScanForward(&index, (unsigned long)(mask >> 32)) ? (int)index + 32 : -1;
+#elif defined(__GNUC__)
+	return mask != 0 ? __builtin_ctzll(mask) : -1;
+#else
+	if ((UInt32)mask)
+		return LowestBit((UInt32)mask);
+	return mask != 0 ? LowestBit((UInt32)(mask >> 32)) + 32 : -1;
+#endif
+}
+
+// number of set bits in the 32 bit mask
+inline int PopCount(UInt32 v)
+{
+	// MSVC only has the popcnt instruction, which older CPUs lack. GCC picks the instruction
+	// when the target has it (-mpopcnt) and a bit trick like BitsInMask otherwise.
+#if defined(_MSC_VER) && defined(__AVX__)
+	return (int)__popcnt(v);
+#elif defined(__GNUC__)
+	return __builtin_popcount(v);
+#else
+	return BitsInMask(v);
+#endif
+}
+
+// number of set bits in the 64 bit mask
+inline int PopCount64(UInt64 v)
+{
+#if defined(_MSC_VER) && defined(__AVX__) && defined(_M_X64)
+	return (int)__popcnt64(v);
+#elif defined(__GNUC__)
+	return __builtin_popcountll(v);
+#else
+	return BitsInMask64(v);
+#endif
+}
+
 // reverse bit order
 inline void ReverseBits(UInt32& mask)
 {
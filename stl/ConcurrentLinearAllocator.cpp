@@ -0,0 +1,279 @@
+#include "UnityPrefix.h"
+#include "ConcurrentLinearAllocator.h"
+#include "AtomicOps.h"
+#include "MemoryManager.h"
+#include "BitUtility.h"
+#include "StaticAssert.h"
+
+UNITY_TLS_VALUE(size_t) ConcurrentLinearAllocator::s_ThreadSlotIndex;
+volatile UInt64 ConcurrentLinearAllocator::s_UsedThreadSlots = 0;
+
+static void* AllocateChunkMemory(size_t size)
+{
+#if ENABLE_MEMORY_MANAGER
+	return MemoryManager::LowLevelAllocate(size);
+#else
+	return malloc(size);
+#endif
+}
+
+static void FreeChunkMemory(void* ptr)
+{
+#if ENABLE_MEMORY_MANAGER
+	MemoryManager::LowLevelFree(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+ConcurrentLinearAllocator::ConcurrentLinearAllocator(size_t chunkSize, const char* name)
+	: BaseAllocator(name)
+	, m_CurrentChunk(NULL)
+	, m_Chunks(NULL)
+	, m_FreeChunks(NULL)
+	, m_ChunkSize(chunkSize)
+	, m_Generation(1)
+{
+	CompileTimeAssert(sizeof(ThreadSlot) == kCacheLineSize, "ThreadSlot should fill a cache line");
+	CompileTimeAssert(kMaxThreadSlots <= 64, "thread slots are handed out from a 64 bit mask");
+	// chunk offsets are ints
+	Assert(chunkSize <= kMaxChunkSize);
+	m_ChunkSize = std::min<size_t>(chunkSize, kMaxChunkSize);
+
+	const size_t slotsSize = kMaxThreadSlots * sizeof(ThreadSlot);
+	m_ThreadSlotsMemory = AllocateChunkMemory(slotsSize + kCacheLineSize);
+	m_ThreadSlots = (ThreadSlot*)AlignPtr(m_ThreadSlotsMemory, kCacheLineSize);
+	memset(m_ThreadSlots, 0, slotsSize);
+	m_TotalReservedMemory += slotsSize + kCacheLineSize;
+}
+
+ConcurrentLinearAllocator::~ConcurrentLinearAllocator()
+{
+	Reset(true);
+	FreeChunkMemory(m_ThreadSlotsMemory);
+}
+
+ConcurrentLinearAllocator::ThreadSlot* ConcurrentLinearAllocator::GetThreadSlot()
+{
+	size_t index = s_ThreadSlotIndex;
+	if (index != 0)
+		return &m_ThreadSlots[index - 1];
+
+	// take the lowest free index
+	for (;;)
+	{
+		UInt64 used = AtomicRead64(&s_UsedThreadSlots);
+		if (~used == 0)
+			return NULL;
+		int bit = LowestBit64(~used);
+		if (AtomicCompareExchange64(&s_UsedThreadSlots, used | ((UInt64)1 << bit), used))
+		{
+			s_ThreadSlotIndex = bit + 1;
+			return &m_ThreadSlots[bit];
+		}
+	}
+}
+
+void ConcurrentLinearAllocator::ReleaseThreadSlot()
+{
+	size_t index = s_ThreadSlotIndex;
+	if (index == 0)
+		return;
+	s_ThreadSlotIndex = 0;
+
+	// the next thread with this index continues in the sub-chunks this thread left behind
+	for (;;)
+	{
+		UInt64 used = AtomicRead64(&s_UsedThreadSlots);
+		if (AtomicCompareExchange64(&s_UsedThreadSlots, used & ~((UInt64)1 << (index - 1)), used))
+			break;
+	}
+}
+
+void* ConcurrentLinearAllocator::Allocate(size_t size, int align)
+{
+	ThreadSlot* slot = GetThreadSlot();
+	if (slot == NULL)
+		return AllocateShared(size, align);
+
+	if (slot->generation == m_Generation)
+	{
+		char* ptr = (char*)AlignPtr(slot->current, align);
+		if (ptr <= slot->end && size <= (size_t)(slot->end - ptr))
+		{
+			slot->current = ptr + size;
+			return ptr;
+		}
+	}
+
+	// large allocations would waste most of a sub-chunk
+	if (size > kSubChunkSize / 4 || size + align > kSubChunkSize / 4)
+		return AllocateShared(size, align);
+
+	char* subChunk = (char*)AllocateShared(kSubChunkSize, kDefaultMemoryAlignment);
+	if (subChunk == NULL)
+		return NULL;
+
+	char* ptr = (char*)AlignPtr(subChunk, align);
+	slot->current = ptr + size;
+	slot->end = subChunk + kSubChunkSize;
+	slot->generation = m_Generation;
+	return ptr;
+}
+
+void* ConcurrentLinearAllocator::AllocateShared(size_t size, int align)
+{
+	size_t paddedSize = size + align - 1;
+	// checked before converting to the int offset, so huge sizes can't wrap it around
+	if (size > m_ChunkSize || paddedSize > m_ChunkSize)
+		return AllocateOversized(size, align);
+
+	for (;;)
+	{
+		Chunk* chunk = m_CurrentChunk;
+		if (chunk != NULL)
+		{
+			// the offset is only advanced while the allocation fits, so it never runs past the end
+			// and can't overflow, however many threads race for the last bytes
+			int used = chunk->used;
+			if (used <= chunk->size - (int)paddedSize)
+			{
+				if (AtomicCompareExchange(&chunk->used, used + (int)paddedSize, used))
+					return AlignPtr(chunk->GetData() + used, align);
+				continue;
+			}
+		}
+
+		if (!AddChunk(chunk))
+			return NULL;
+	}
+}
+
+void* ConcurrentLinearAllocator::AllocateOversized(size_t size, int align)
+{
+	size_t paddedSize = size + align - 1;
+	if (size > kMaxChunkSize || paddedSize > kMaxChunkSize)
+		return NULL;
+
+	Chunk* chunk = (Chunk*)AllocateChunkMemory(kChunkHeaderSize + paddedSize);
+	if (chunk == NULL)
+		return NULL;
+	chunk->size = (int)paddedSize;
+	chunk->used = (int)paddedSize;
+
+	// full from the start, so it is never allocated from. It isn't kept over a reset either.
+	Mutex::AutoLock lock(m_ChunkMutex);
+	m_TotalReservedMemory += kChunkHeaderSize + paddedSize;
+	chunk->next = m_Chunks;
+	m_Chunks = chunk;
+	return AlignPtr(chunk->GetData(), align);
+}
+
+bool ConcurrentLinearAllocator::AddChunk(Chunk* fullChunk)
+{
+	Mutex::AutoLock lock(m_ChunkMutex);
+
+	// another thread already chained in a new chunk
+	if (m_CurrentChunk != fullChunk)
+		return true;
+
+	Chunk* chunk = NULL;
+	if (m_FreeChunks != NULL)
+	{
+		chunk = m_FreeChunks;
+		m_FreeChunks = chunk->next;
+	}
+	else
+	{
+		chunk = (Chunk*)AllocateChunkMemory(kChunkHeaderSize + m_ChunkSize);
+		if (chunk == NULL)
+			return false;
+		chunk->size = m_ChunkSize;
+		m_TotalReservedMemory += kChunkHeaderSize + m_ChunkSize;
+	}
+
+	chunk->used = 0;
+	chunk->next = m_Chunks;
+	m_Chunks = chunk;
+	m_CurrentChunk = chunk;
+	return true;
+}
+
+void* ConcurrentLinearAllocator::Reallocate(void* p, size_t size, int align)
+{
+	// allocations don't store their size, so there is nothing to copy from
+	if (p != NULL)
+	{
+		ErrorString("ConcurrentLinearAllocator does not support reallocation");
+		return NULL;
+	}
+	return Allocate(size, align);
+}
+
+bool ConcurrentLinearAllocator::Contains(const void* p)
+{
+	// any thread may ask while Reset(true) frees the chunks
+	Mutex::AutoLock lock(m_ChunkMutex);
+	for (Chunk* chunk = m_Chunks; chunk != NULL; chunk = chunk->next)
+	{
+		if (p >= chunk->GetData() && p < chunk->GetData() + chunk->size)
+			return true;
+	}
+	return false;
+}
+
+size_t ConcurrentLinearAllocator::GetAllocatedMemorySize() const
+{
+	size_t total = 0;
+	for (Chunk* chunk = m_Chunks; chunk != NULL; chunk = chunk->next)
+		total += chunk->used;
+	return total;
+}
+
+size_t ConcurrentLinearAllocator::GetAllocatorSizeTotalUsed() const
+{
+	return GetAllocatedMemorySize();
+}
+
+void ConcurrentLinearAllocator::FillUsedMemory(int value)
+{
+	Mutex::AutoLock lock(m_ChunkMutex);
+
+	for (Chunk* chunk = m_Chunks; chunk != NULL; chunk = chunk->next)
+		memset(chunk->GetData(), value, chunk->used);
+}
+
+void ConcurrentLinearAllocator::Reset(bool releaseChunks)
+{
+	Mutex::AutoLock lock(m_ChunkMutex);
+
+	// sub-chunks of the previous generation are dropped on their next use
+	AtomicIncrement(&m_Generation);
+	m_CurrentChunk = NULL;
+
+	while (m_Chunks != NULL)
+	{
+		Chunk* chunk = m_Chunks;
+		m_Chunks = chunk->next;
+		if (chunk->size != (int)m_ChunkSize)
+		{
+			// oversized chunks are only used once
+			m_TotalReservedMemory -= kChunkHeaderSize + chunk->size;
+			FreeChunkMemory(chunk);
+			continue;
+		}
+		chunk->next = m_FreeChunks;
+		m_FreeChunks = chunk;
+	}
+
+	if (releaseChunks)
+	{
+		while (m_FreeChunks != NULL)
+		{
+			Chunk* chunk = m_FreeChunks;
+			m_FreeChunks = chunk->next;
+			m_TotalReservedMemory -= kChunkHeaderSize + chunk->size;
+			FreeChunkMemory(chunk);
+		}
+	}
+}
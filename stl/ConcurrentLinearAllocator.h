@@ -0,0 +1,90 @@
+#ifndef CONCURRENT_LINEAR_ALLOCATOR_H_
+#define CONCURRENT_LINEAR_ALLOCATOR_H_
+
+#include "BaseAllocator.h"
+#include "Mutex.h"
+#include "ThreadSpecificValue.h"
+#include "MemoryMacros.h"
+
+// Linear allocator that several threads can allocate from at the same time.
+// Allocations advance an atomic offset in the current chunk, a new chunk is chained
+// in when it is full. To keep contention down, each thread reserves small sub-chunks
+// and bumps inside those without atomics. Large allocations go to the chunk directly.
+//
+// Deallocate does nothing, all memory is released at once with Reset. Reset must not
+// be called while other threads are still allocating (e.g. after the frame's jobs completed).
+// Chunks are kept for the next frame unless Reset is asked to release them.
+// Allocations that don't fit into a chunk get a chunk of their own, which the next Reset frees.
+
+class ConcurrentLinearAllocator : public BaseAllocator
+{
+public:
+	ConcurrentLinearAllocator(size_t chunkSize, const char* name);
+	virtual ~ConcurrentLinearAllocator();
+
+	virtual void* Allocate (size_t size, int align);
+	virtual void* Reallocate (void* p, size_t size, int align);
+	virtual void Deallocate (void* p) {}
+	virtual bool Contains (const void* p);
+
+	virtual size_t GetAllocatedMemorySize() const;
+	virtual size_t GetAllocatorSizeTotalUsed() const;
+
+	void Reset (bool releaseChunks = false);
+	// overwrite everything handed out since the last reset, to make stale reads visible
+	void FillUsedMemory (int value);
+
+	// hands the calling thread's slot to the next thread, call when a thread that allocated exits
+	static void ReleaseThreadSlot ();
+
+private:
+	struct Chunk
+	{
+		Chunk*	next;
+		volatile int used;
+		int		size;
+
+		char*	GetData() { return (char*)this + kChunkHeaderSize; }
+	};
+
+	// sub-chunk a thread is bumping in, only touched by that thread.
+	// A cache line each, so threads bumping next to each other don't share lines.
+	struct ThreadSlot
+	{
+		char*	current;
+		char*	end;
+		int		generation;
+		char	padding[kCacheLineSize - 2 * sizeof(char*) - sizeof(int)];
+	};
+
+	enum
+	{
+		kChunkHeaderSize = 16,
+		kMaxChunkSize = 0x3FFFFFFF, // offsets are ints
+		kSubChunkSize = 4*1024,
+		kMaxThreadSlots = 64
+	};
+
+	void* AllocateShared (size_t size, int align);
+	void* AllocateOversized (size_t size, int align);
+	bool  AddChunk (Chunk* fullChunk);
+	ThreadSlot* GetThreadSlot ();
+
+	Chunk* volatile	m_CurrentChunk;
+	Chunk*		m_Chunks; // all chunks in use, newest first
+	Chunk*		m_FreeChunks; // chunks kept over a reset
+	size_t		m_ChunkSize;
+	volatile int m_Generation;
+	Mutex		m_ChunkMutex;
+
+	ThreadSlot*	m_ThreadSlots; // kMaxThreadSlots, cache line aligned
+	void*		m_ThreadSlotsMemory;
+
+	// because TLS values have to be static on some platforms, the slot index is per thread
+	// and shared by all instances. Indices are handed out from a bit mask and given back by
+	// ReleaseThreadSlot, so only live threads hold one. While all are taken, threads go to the chunk directly.
+	static UNITY_TLS_VALUE(size_t) s_ThreadSlotIndex; // 1 based, 0 when not assigned yet
+	static volatile UInt64 s_UsedThreadSlots;
+};
+
+#endif
@@ -3,8 +3,6 @@
 #include "AtomicOps.h"
 #include "MemoryManager.h"
 
-///@TODO: Use 24 bits for refcount
-///@TODO: Handle ref count overflow
 #define Assert(x)
 void ConstantString::create_empty ()
 {
@@ -13,43 +11,6 @@ void ConstantString::create_empty ()
 	Assert(!owns_string());
 }
 
-// The header compressed the label and refcount into a 32 bits.
-// Refcount lives on the 0xFFFF, label lives on the higher bits.
-// We use atomic ops for thread safety on refcounting when deleting ConstantStrings.
-struct AllocatedStringHeader
-{
-	volatile int refCountAndLabel;
-};
-
-MemLabelId GetLabel (const AllocatedStringHeader& header)
-{
-	int intLabel = (header.refCountAndLabel & (0x0000FFFF)) << 16;
-	ProfilerAllocationHeader* root = GET_ALLOC_HEADER(&GetConstantStringManager(), kMemString);
-	MemLabelId label( (MemLabelIdentifier)intLabel, root);
-	return label;
-}
-
-void SetLabel (AllocatedStringHeader& header, MemLabelId label)
-{
-	int labelInt = label.label;
-	Assert(labelInt < 0xFFFF);
-	labelInt <<= 16;
-
-	header.refCountAndLabel &= 0x0000FFFF;
-	header.refCountAndLabel |= labelInt;
-}
-
-int GetRefCount (int refCountAndLabel)
-{
-	return refCountAndLabel & 0xFFFF;
-}
-
-
-inline static AllocatedStringHeader* GetHeader (const char* ptr)
-{
-	return reinterpret_cast<AllocatedStringHeader*> (const_cast<char*> (ptr) - sizeof(AllocatedStringHeader));
-}
-
 void ConstantString::operator = (const ConstantString& input)
 {
 	assign(input);
@@ -57,11 +18,14 @@ void ConstantString::operator = (const ConstantString& input)
 
 void ConstantString::assign (const ConstantString& input)
 {
+	// cleanup would release the string before it is retained again
+	if (&input == this)
+		return;
 	cleanup();
 	m_Buffer = input.m_Buffer;
 	if (owns_string())
 	{
-		AtomicIncrement(&GetHeader (get_char_ptr_fast())->refCountAndLabel);
+		ConstantStringManager::RetainInternedString(get_char_ptr_fast());
 	}
 }
 
@@ -69,27 +33,27 @@ void ConstantString::assign (const ConstantString& input)
 void ConstantString::assign (const char* str, MemLabelId label)
 {
 	cleanup();
-	const char* constantString = GetConstantStringManager().GetConstantString(str);
-	// Own Strings
+	size_t length = strlen(str);
+	UInt32 hash = ConstantStringHash(str, length);
+	const char* constantString = GetConstantStringManager().GetConstantString(str, length, hash);
 	if (constantString == NULL)
 	{
-		//label.SetRootHeader(GET_ALLOC_HEADER(&GetConstantStringManager(), kMemString));
-		size_t length = strlen(str);
-		//char* allocated = (char*)GetMemoryManager ().Allocate(length + 1 + sizeof(AllocatedStringHeader), kDefaultMemoryAlignment, label, kAllocateOptionNone, __FILE_STRIPPED__, __LINE__);
-		char* allocated = (char*)UNITY_MALLOC (label, length + 1 + sizeof(AllocatedStringHeader));
-		char* allocatedString = allocated + sizeof(AllocatedStringHeader);
-
-		AllocatedStringHeader& header = *GetHeader (allocatedString);
-		header.refCountAndLabel = 1;
-		SetLabel(header, label);
-
-		Assert(GetRefCount(header.refCountAndLabel) == 1);
-		memcpy(allocatedString, str, length);
-		allocatedString[length] = 0;
-
+		assign_allocated(str, length, hash, label);
+	}
+	else
+	{
+		m_Buffer = constantString;
+		Assert(!owns_string());
+	}
+}
 
-		m_Buffer = reinterpret_cast<char*> (reinterpret_cast<size_t> (allocatedString) | 1);
-		Assert(owns_string());
+void ConstantString::assign (const ConstantStringLiteral& literal, MemLabelId label)
+{
+	cleanup();
+	const char* constantString = GetConstantStringManager().GetConstantString(literal.str, literal.length, literal.hash);
+	if (constantString == NULL)
+	{
+		assign_allocated(literal.str, literal.length, literal.hash, label);
 	}
 	else
 	{
@@ -98,23 +62,20 @@ void ConstantString::assign (const char* str, MemLabelId label)
 	}
 }
 
+// Own Strings
+// Equal strings share the copy in the intern table, the label is the one of the ConstantString that created it
+void ConstantString::assign_allocated (const char* str, size_t length, UInt32 hash, MemLabelId label)
+{
+	const char* internedString = GetConstantStringManager().InternString(str, length, hash, label);
+	m_Buffer = reinterpret_cast<char*> (reinterpret_cast<size_t> (internedString) | 1);
+	Assert(owns_string());
+}
+
 void ConstantString::cleanup ()
 {
 	if (owns_string())
 	{
-		AllocatedStringHeader* header = GetHeader(get_char_ptr_fast ());
-
-		int newRefCount = AtomicDecrement (&header->refCountAndLabel);
-		newRefCount = GetRefCount(newRefCount);
-
-		if (newRefCount == 0)
-		{
-		//	int intLabel = (header->refCountAndLabel & (0x0000FFFF)) << 16;
-			//ProfilerAllocationHeader* root = GET_ALLOC_HEADER(&GetConstantStringManager(), kMemString);
-		//	MemLabelId label( (MemLabelIdentifier)intLabel, root);
-			//MemLabelId label = GetLabel(*header);
-			//UNITY_FREE(label, header);
-		}
+		ConstantStringManager::ReleaseInternedString(get_char_ptr_fast());
 	}
 
 	m_Buffer = NULL;
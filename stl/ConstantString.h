@@ -1,8 +1,12 @@
 #pragma once
 #include "AllocatorLabels.h"
 #include "VisualStudioPostPrefix.h"
+#include "ConstantStringManager.h"
+#include "StaticAssert.h"
 #include "string.h"
 #define NULL 0
+struct ConstantStringLiteral;
+
 struct ConstantString
 {
 	ConstantString (const char* str, MemLabelId label)
@@ -11,6 +15,13 @@ struct ConstantString
 		assign (str, label);
 	}
 
+	// the hash of the literal is computed at compile time, common strings are found without hashing at runtime
+	ConstantString (const ConstantStringLiteral& literal, MemLabelId label)
+		: m_Buffer (NULL)
+	{
+		assign (literal, label);
+	}
+
 	ConstantString ()
 		: m_Buffer (NULL)
 	{
@@ -23,22 +34,53 @@ struct ConstantString
 		assign(input);
 	}
 
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	// takes over the reference of input without touching the refcount, input is left empty
+	ConstantString (ConstantString&& input)
+		: m_Buffer (input.m_Buffer)
+	{
+		input.m_Buffer = GetConstantStringManager().GetEmptyString();
+	}
+
+	void operator = (ConstantString&& input)
+	{
+		if (&input == this)
+			return;
+		cleanup();
+		m_Buffer = input.m_Buffer;
+		input.m_Buffer = GetConstantStringManager().GetEmptyString();
+	}
+#endif
+
 	~ConstantString ();
 
 	void assign (const char* str, MemLabelId label);
+	void assign (const ConstantStringLiteral& literal, MemLabelId label);
 	void assign (const ConstantString& input);
 
 	void operator = (const ConstantString& input);
 
 	const char* c_str() const { return get_char_ptr_fast (); }
-	bool empty () const       { return m_Buffer[0] == 0; }
+	bool empty () const       { return get_char_ptr_fast ()[0] == 0; }
+	// length and hash are stored in front of the characters
+	size_t size () const      { return get_header ()->length; }
+	// ConstantStringHash of the characters
+	UInt32 hash () const      { return get_header ()->hash; }
 
+	// Common strings and interned strings are both stored once, so equal strings of the same kind have the same pointer.
+	// Only a string that was interned before an equal common string got registered needs to compare characters.
 	friend bool operator == (const ConstantString& lhs, const ConstantString& rhs)
 	{
-		if (lhs.owns_string () || rhs.owns_string())
-			return strcmp(lhs.c_str(), rhs.c_str()) == 0;
-		else
-			return lhs.m_Buffer == rhs.m_Buffer;
+		if (lhs.m_Buffer == rhs.m_Buffer)
+			return true;
+		if (lhs.owns_string () == rhs.owns_string())
+			return false;
+		return lhs.hash() == rhs.hash() && lhs.size() == rhs.size() && memcmp(lhs.c_str(), rhs.c_str(), lhs.size()) == 0;
+	}
+
+	friend bool operator != (const ConstantString& lhs, const ConstantString& rhs)
+	{
+		return !(lhs == rhs);
 	}
 
 	friend bool operator == (const ConstantString& lhs, const char* rhs)
@@ -65,8 +107,16 @@ private:
 
 	inline bool owns_string () const              { return reinterpret_cast<size_t> (m_Buffer) & 1; }
 	inline const char* get_char_ptr_fast () const { return reinterpret_cast<const char*> (reinterpret_cast<size_t> (m_Buffer) & ~1); }
+	inline const InternedString* get_header () const { return InternedString::FromString (get_char_ptr_fast ()); }
 	void cleanup ();
 	void create_empty ();
+	void assign_allocated (const char* str, size_t length, UInt32 hash, MemLabelId label);
 
 	const char* m_Buffer;
-};
\ No newline at end of file
+};
+
+// Hash functor for containers keyed by ConstantString, returns the stored hash without touching the characters
+struct ConstantStringHashFunctor
+{
+	size_t operator() (const ConstantString& str) const { return str.hash(); }
+};
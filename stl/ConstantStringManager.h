@@ -1,21 +1,153 @@
 #pragma once
 
 #include "dynamic_array.h"
+#include "IntrusiveHashTable.h"
 #include "Mutex.h"
+#include "ThreadSpecificValue.h"
 #include <map>
 
+// FNV-1a hash of the ConstantStrings, GetConstantString looks strings up by (hash, length)
+inline UInt32 ConstantStringHash (const char* str, size_t length)
+{
+	UInt32 hash = 2166136261U;
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ (UInt8)str[i]) * 16777619U;
+	return hash;
+}
+
+// Same hash unrolled over the characters of a string literal. The literal is known at compile time,
+// so an optimizing compiler folds the hash to a constant.
+template <size_t N>
+struct ConstantStringLiteralHash
+{
+	static FORCE_INLINE UInt32 Hash (const char* str) { return (ConstantStringLiteralHash<N - 1>::Hash(str) ^ (UInt8)str[N - 1]) * 16777619U; }
+};
+
+template <>
+struct ConstantStringLiteralHash<0>
+{
+	static FORCE_INLINE UInt32 Hash (const char*) { return 2166136261U; }
+};
+
+// A string literal with its length and hash, for ConstantStrings constructed from literals:
+// ConstantString name (ConstantStringLiteral("TextMesh"), label);
+// Only pass literals, the length is taken from the array size.
+struct ConstantStringLiteral
+{
+	template <size_t N>
+	explicit ConstantStringLiteral (const char (&literal)[N])
+		: str (literal), length (N - 1), hash (ConstantStringLiteralHash<N - 1>::Hash(literal))
+	{
+		DebugAssert(strlen(literal) == N - 1);
+	}
+
+	const char*	str;
+	size_t		length;
+	UInt32		hash;
+};
+
+// Header in front of the characters of every ConstantString, so the hash and length are known without reading the string.
+// Equal strings that are not common strings share one InternedString, so they are compared by pointer.
+// Common strings carry the same header, their refCount is not used.
+struct InternedString : public HashTableElement
+{
+	volatile int		refCount;
+	UInt32				hash;
+	UInt32				length;
+	MemLabelIdentifier	label;
+
+	const char* GetString () const { return reinterpret_cast<const char*> (this + 1); }
+	static InternedString* FromString (const char* str) { return reinterpret_cast<InternedString*> (const_cast<char*> (str)) - 1; }
+};
+
 class ConstantStringManager
 {
 #define PROFILE_COMMON_STRINGS !UNITY_RELEASE
 
 #if PROFILE_COMMON_STRINGS
-	typedef std::map<std::string, int> CommonStringCounter;
-	CommonStringCounter m_CommonStringCounter;
-	Mutex               m_CommonStringMutex;
+	// Lookup counts of one thread, only written by that thread so counting takes no lock.
+	// Open addressing on the hash, strings that don't fit are only counted in notRecorded.
+	struct CommonStringProfile
+	{
+		enum { kSlotCount = 1024, kMaxUsed = kSlotCount * 3 / 4 };
+		struct Slot
+		{
+			const char*	str;
+			UInt32		hash;
+			UInt32		length;
+			int			count;
+		};
+
+		Slot					slots[kSlotCount];
+		int						used;
+		int						notRecorded;
+		int						sampleCounter;
+		CommonStringProfile*	next;
+	};
+
+	// the profile of the thread and the manager it belongs to, a profile of an earlier manager is freed already
+	static UNITY_TLS_VALUE(CommonStringProfile*) s_CommonStringProfile;
+	static UNITY_TLS_VALUE(UInt32) s_CommonStringProfileId;
+	// profiles of all threads that looked up strings, the mutex is only taken to add one and to report
+	CommonStringProfile*	m_CommonStringProfiles;
+	Mutex					m_CommonStringMutex;
+	UInt32					m_ProfileId;
+	int						m_CommonStringSampleRate;
+
+	CommonStringProfile* CreateCommonStringProfile ();
 #endif
 
-	dynamic_array<const char*> m_Strings;
-	void ProfileCommonString (const char* str);
+	struct Entry
+	{
+		const char*	str;
+		UInt32		length;
+		UInt32		hash;
+	};
+
+	dynamic_array<Entry>  m_Strings;
+	// open addressing table of indices into m_Strings + 1, 0 for empty slots. At most half full.
+	dynamic_array<UInt32> m_Index;
+
+	struct InternKey
+	{
+		const char*	str;
+		UInt32		length;
+		UInt32		hash;
+	};
+
+	struct InternTraits
+	{
+		typedef InternKey KeyType;
+		static KeyType GetKey (const InternedString& s) { InternKey key = { s.GetString(), s.length, s.hash }; return key; }
+		static size_t Hash (const KeyType& key) { return key.hash; }
+		static bool Equal (const KeyType& a, const KeyType& b) { return a.length == b.length && memcmp(a.str, b.str, a.length) == 0; }
+	};
+
+	// The intern table is split by the top bits of the hash, threads interning different strings rarely wait for each other
+	enum { kInternShardBits = 4, kInternShardCount = 1 << kInternShardBits };
+	// bucket array of a shard, declared before the table so the table is destroyed first
+	struct InternBuckets
+	{
+		InternBuckets () : buckets (NULL) {}
+		~InternBuckets () { if (buckets != NULL) UNITY_FREE(kMemString, buckets); }
+
+		HashTableElement** buckets;
+	};
+
+	struct InternShard
+	{
+		Mutex											mutex;
+		InternBuckets									buckets;
+		IntrusiveHashTable<InternedString, InternTraits>	table;
+		char											padding[kCacheLineSize];
+	};
+	InternShard m_InternShards[kInternShardCount];
+
+	InternShard& GetInternShard (UInt32 hash) { return m_InternShards[hash >> (32 - kInternShardBits)]; }
+
+	void ProfileCommonString (const char* str, size_t length, UInt32 hash);
+	void AddToIndex (UInt32 stringIndex);
+	void RebuildIndex (size_t slotCount);
 
 public:
 
@@ -25,15 +157,33 @@ public:
 	void AddConstantStrings (const char** strings, size_t size );
 	void AddConstantString (const char* strings );
 
+	// the registered common string equal to str, NULL if there is none
 	const char* GetConstantString(const char* str);
+	const char* GetConstantString(const char* str, size_t length, UInt32 hash);
 	const char* GetEmptyString();
 
+	// The shared copy of str with one more reference. It is allocated from label when no other ConstantString holds the same string.
+	const char* InternString (const char* str, size_t length, UInt32 hash, MemLabelId label);
+	// Adds a reference to a string returned by InternString
+	static void RetainInternedString (const char* str);
+	// Removes a reference, the last one frees the string
+	static void ReleaseInternedString (const char* str);
+	size_t GetInternedStringCount ();
+
 	// Init
 	static void StaticInitialize ();
 	static void StaticCleanup ();
 
 	void DumpCommonStrings ();
 
+#if PROFILE_COMMON_STRINGS
+	typedef std::map<std::string, int> CommonStringCounter;
+	// Adds up the counts of all threads. With sampling the counts are estimates, the sampled count times the rate.
+	void CollectCommonStrings (CommonStringCounter& counts);
+	// Count only every rate-th lookup on each thread, 1 counts all of them
+	void SetCommonStringSampleRate (int rate) { m_CommonStringSampleRate = rate; }
+#endif
+
 };
 
 ConstantStringManager& GetConstantStringManager ();
@@ -0,0 +1,117 @@
+#include "UnityPrefix.h"
+#include "FrameAllocator.h"
+#include "MemoryMacros.h"
+
+FrameAllocator::FrameAllocator(size_t chunkSize, int frameCount, const char* name)
+	: BaseAllocator(name)
+	, m_CurrentBuffer(0)
+{
+	Assert(frameCount >= 1 && frameCount <= kMaxFrameCount);
+	m_FrameCount = std::min(std::max(frameCount, 1), (int)kMaxFrameCount);
+#if ENABLE_FRAME_ALLOCATOR_POISON
+	m_BufferCount = m_FrameCount + 1;
+#else
+	m_BufferCount = m_FrameCount;
+#endif
+
+	memset(m_Buffers, 0, sizeof(m_Buffers));
+	for (int i = 0; i < m_BufferCount; i++)
+		m_Buffers[i] = UNITY_NEW(ConcurrentLinearAllocator(chunkSize, name), kMemManager);
+}
+
+FrameAllocator::~FrameAllocator()
+{
+	for (int i = 0; i < m_BufferCount; i++)
+		UNITY_DELETE(m_Buffers[i], kMemManager);
+}
+
+void* FrameAllocator::Allocate(size_t size, int align)
+{
+	// the requested size is stored in front of the allocation, for Reallocate and GetPtrSize.
+	// A header of align bytes keeps the returned pointer aligned.
+	align = std::max<int>(align, sizeof(size_t));
+
+	char* ptr = (char*)m_Buffers[m_CurrentBuffer]->Allocate(size + align, align);
+	if (ptr == NULL)
+		return NULL;
+
+	ptr += align;
+	((size_t*)ptr)[-1] = size;
+	return ptr;
+}
+
+void* FrameAllocator::Reallocate(void* p, size_t size, int align)
+{
+	if (p == NULL)
+		return Allocate(size, align);
+
+#if ENABLE_FRAME_ALLOCATOR_POISON
+	if (m_Buffers[(m_CurrentBuffer + 1) % m_BufferCount]->Contains(p))
+		ErrorString("FrameAllocator: reallocating memory of a frame that has already ended");
+#endif
+
+	size_t oldSize = GetPtrSize(p);
+	if (size <= oldSize && ((size_t)p & (align - 1)) == 0)
+	{
+		// the tail is released with the frame anyway
+		((size_t*)p)[-1] = size;
+		return p;
+	}
+
+	void* newPtr = Allocate(size, align);
+	if (newPtr != NULL)
+		memcpy(newPtr, p, std::min(size, oldSize));
+	return newPtr;
+}
+
+bool FrameAllocator::Contains(const void* p)
+{
+	for (int i = 0; i < m_BufferCount; i++)
+	{
+		if (m_Buffers[i]->Contains(p))
+			return true;
+	}
+	return false;
+}
+
+size_t FrameAllocator::GetAllocatedMemorySize() const
+{
+	size_t total = 0;
+	for (int i = 0; i < m_BufferCount; i++)
+		total += m_Buffers[i]->GetAllocatedMemorySize();
+	return total;
+}
+
+size_t FrameAllocator::GetAllocatorSizeTotalUsed() const
+{
+	return GetAllocatedMemorySize();
+}
+
+size_t FrameAllocator::GetReservedSizeTotal() const
+{
+	size_t total = 0;
+	for (int i = 0; i < m_BufferCount; i++)
+		total += m_Buffers[i]->GetReservedSizeTotal();
+	return total;
+}
+
+size_t FrameAllocator::GetPtrSize(const void* ptr) const
+{
+	return ((const size_t*)ptr)[-1];
+}
+
+void FrameAllocator::FrameMaintenance(bool cleanup)
+{
+	// the buffer rotating in was filled m_BufferCount frames ago
+	int next = (m_CurrentBuffer + 1) % m_BufferCount;
+	m_Buffers[next]->Reset(cleanup);
+
+#if ENABLE_FRAME_ALLOCATOR_POISON
+	// the oldest frame that was still alive has ended now. Its buffer sits out one frame
+	// before it is reset, so stale pointers into it read the pattern.
+	int retired = (next + 1) % m_BufferCount;
+	m_Buffers[retired]->FillUsedMemory(kPoisonValue);
+#endif
+
+	m_CurrentBuffer = next;
+}
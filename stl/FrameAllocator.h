@@ -0,0 +1,54 @@
+#ifndef FRAME_ALLOCATOR_H_
+#define FRAME_ALLOCATOR_H_
+
+#include "BaseAllocator.h"
+#include "ConcurrentLinearAllocator.h"
+
+// Retired buffers are filled with a pattern and kept out of use for one extra frame,
+// so data that is read after its lifetime ended shows up as garbage.
+#ifndef ENABLE_FRAME_ALLOCATOR_POISON
+#define ENABLE_FRAME_ALLOCATOR_POISON DEBUGMODE
+#endif
+
+// Allocator for data that only has to live until the end of the next frame(s).
+// Allocations go to one of frameCount rotating linear buffers. FrameMaintenance advances
+// to the next buffer and resets the one that was filled frameCount frames ago, so memory
+// is never freed piece by piece. Deallocate does nothing.
+//
+// Allocating is thread safe. FrameMaintenance must be called from the main thread
+// while no allocations of the retired frame are still in flight.
+
+class FrameAllocator : public BaseAllocator
+{
+public:
+	FrameAllocator(size_t chunkSize, int frameCount, const char* name);
+	virtual ~FrameAllocator();
+
+	virtual void* Allocate (size_t size, int align);
+	virtual void* Reallocate (void* p, size_t size, int align);
+	virtual void  Deallocate (void* p) {}
+	virtual bool  Contains (const void* p);
+
+	virtual size_t GetAllocatedMemorySize() const;
+	virtual size_t GetAllocatorSizeTotalUsed() const;
+	virtual size_t GetReservedSizeTotal() const;
+	virtual size_t GetPtrSize(const void* ptr) const;
+
+	virtual void FrameMaintenance(bool cleanup);
+
+	int GetFrameCount() const { return m_FrameCount; }
+
+private:
+	enum
+	{
+		kMaxFrameCount = 4,
+		kPoisonValue = 0xDD
+	};
+
+	ConcurrentLinearAllocator* m_Buffers[kMaxFrameCount + 1];
+	int				m_FrameCount;
+	int				m_BufferCount; // one more than m_FrameCount when poisoning
+	volatile int	m_CurrentBuffer;
+};
+
+#endif
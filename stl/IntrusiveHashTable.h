@@ -0,0 +1,237 @@
+#ifndef INTRUSIVE_HASH_TABLE_H
+#define INTRUSIVE_HASH_TABLE_H
+
+#include <string.h>
+
+#if !UNITY_RELEASE
+#define INTRUSIVE_HASH_ASSERT(x) Assert(x)
+#else
+#define INTRUSIVE_HASH_ASSERT(x)
+#endif
+
+// Hash table of objects that embed their own link, like List does for ListElement.
+// Insert and Erase never allocate. The bucket array is owned by the caller and handed in with
+// SetBuckets, so the table can be used inside allocators: grow it when NeedsGrow() says so,
+// with memory from wherever is allowed at that point.
+//
+// Traits provides:
+//   typedef ... KeyType;
+//   static KeyType GetKey(const T& element);
+//   static size_t Hash(const KeyType& key);
+//   static bool Equal(const KeyType& a, const KeyType& b);
+//
+// Keys may be inserted more than once, Find returns one of the elements.
+
+class HashTableElement
+{
+public:
+	HashTableElement() : m_NextInBucket(NULL), m_Hash(0) { SetTable(NULL); }
+	~HashTableElement() { INTRUSIVE_HASH_ASSERT(!IsInTable()); }
+
+#if !UNITY_RELEASE
+	bool IsInTable() const { return m_Table != NULL; }
+#endif
+
+private:
+	// Non copyable
+	HashTableElement(const HashTableElement&);
+	HashTableElement& operator=(const HashTableElement&);
+
+	HashTableElement*	m_NextInBucket;
+	size_t				m_Hash;
+
+	template <class T, class Traits> friend class IntrusiveHashTable;
+	template <class T> friend class IntrusiveHashTableIterator;
+
+#if !UNITY_RELEASE
+	void SetTable(void* table) { m_Table = table; }
+	void* m_Table;
+#else
+	void SetTable(void*) {}
+#endif
+};
+
+template <class T>
+class IntrusiveHashTableIterator
+{
+public:
+	IntrusiveHashTableIterator() : m_Node(NULL), m_Bucket(NULL), m_BucketsEnd(NULL) {}
+	IntrusiveHashTableIterator(HashTableElement** bucket, HashTableElement** bucketsEnd) : m_Node(NULL), m_Bucket(bucket), m_BucketsEnd(bucketsEnd) { SkipEmptyBuckets(); }
+
+	IntrusiveHashTableIterator& operator++()
+	{
+		m_Node = m_Node->m_NextInBucket;
+		if (m_Node == NULL)
+		{
+			++m_Bucket;
+			SkipEmptyBuckets();
+		}
+		return *this;
+	}
+	IntrusiveHashTableIterator operator++(int) { IntrusiveHashTableIterator ret(*this); ++(*this); return ret; }
+
+	T& operator*() const  { return static_cast<T&>(*m_Node); }
+	T* operator->() const { return static_cast<T*>(m_Node); }
+
+	friend bool operator !=(const IntrusiveHashTableIterator& x, const IntrusiveHashTableIterator& y) { return x.m_Node != y.m_Node; }
+	friend bool operator ==(const IntrusiveHashTableIterator& x, const IntrusiveHashTableIterator& y) { return x.m_Node == y.m_Node; }
+
+private:
+	void SkipEmptyBuckets()
+	{
+		while (m_Bucket != m_BucketsEnd && *m_Bucket == NULL)
+			++m_Bucket;
+		m_Node = m_Bucket != m_BucketsEnd ? *m_Bucket : NULL;
+	}
+
+	HashTableElement*	m_Node;
+	HashTableElement**	m_Bucket;
+	HashTableElement**	m_BucketsEnd;
+};
+
+template <class T, class Traits>
+class IntrusiveHashTable
+{
+public:
+	typedef IntrusiveHashTableIterator<T> iterator;
+	typedef typename Traits::KeyType KeyType;
+
+	IntrusiveHashTable() : m_Buckets(NULL), m_BucketCount(0), m_Size(0) {}
+	// bucketCount must be a power of two
+	IntrusiveHashTable(HashTableElement** buckets, size_t bucketCount) : m_Buckets(NULL), m_BucketCount(0), m_Size(0) { SetBuckets(buckets, bucketCount); }
+	~IntrusiveHashTable() { clear(); }
+
+	// Moves all elements to the new bucket array and returns the old one, for the caller to free.
+	// bucketCount must be a power of two.
+	inline HashTableElement** SetBuckets(HashTableElement** buckets, size_t bucketCount);
+
+	// true when the chains get longer than one element on average
+	bool NeedsGrow() const { return m_Size >= m_BucketCount; }
+	// memory SetBuckets needs for bucketCount buckets
+	static size_t GetBucketsSize(size_t bucketCount) { return bucketCount * sizeof(HashTableElement*); }
+	size_t GetBucketCount() const { return m_BucketCount; }
+
+	inline void insert(T& element);
+	inline T* find(const KeyType& key) const;
+	// returns false if the element is not in the table
+	inline bool erase(T& element);
+
+	iterator begin() const { return iterator(m_Buckets, m_Buckets + m_BucketCount); }
+	iterator end() const { return iterator(); }
+
+	size_t size() const { return m_Size; }
+	bool empty() const { return m_Size == 0; }
+
+	// unlinks all elements, the buckets are kept
+	inline void clear();
+
+private:
+	// Non copyable
+	IntrusiveHashTable(const IntrusiveHashTable&);
+	IntrusiveHashTable& operator=(const IntrusiveHashTable&);
+
+	HashTableElement*& GetBucket(size_t hash) const { return m_Buckets[hash & (m_BucketCount - 1)]; }
+
+	HashTableElement**	m_Buckets;
+	size_t				m_BucketCount;
+	size_t				m_Size;
+};
+
+
+template <class T, class Traits>
+HashTableElement** IntrusiveHashTable<T, Traits>::SetBuckets(HashTableElement** buckets, size_t bucketCount)
+{
+	INTRUSIVE_HASH_ASSERT(bucketCount > 0 && (bucketCount & (bucketCount - 1)) == 0);
+
+	HashTableElement** oldBuckets = m_Buckets;
+	size_t oldBucketCount = m_BucketCount;
+
+	memset(buckets, 0, GetBucketsSize(bucketCount));
+	m_Buckets = buckets;
+	m_BucketCount = bucketCount;
+
+	for (size_t i = 0; i < oldBucketCount; i++)
+	{
+		HashTableElement* node = oldBuckets[i];
+		while (node != NULL)
+		{
+			HashTableElement* next = node->m_NextInBucket;
+			HashTableElement*& bucket = GetBucket(node->m_Hash);
+			node->m_NextInBucket = bucket;
+			bucket = node;
+			node = next;
+		}
+	}
+	return oldBuckets;
+}
+
+template <class T, class Traits>
+void IntrusiveHashTable<T, Traits>::insert(T& element)
+{
+	HashTableElement& node = element;
+	INTRUSIVE_HASH_ASSERT(m_BucketCount != 0);
+	INTRUSIVE_HASH_ASSERT(!node.IsInTable());
+
+	node.m_Hash = Traits::Hash(Traits::GetKey(element));
+	HashTableElement*& bucket = GetBucket(node.m_Hash);
+	node.m_NextInBucket = bucket;
+	node.SetTable(this);
+	bucket = &node;
+	m_Size++;
+}
+
+template <class T, class Traits>
+T* IntrusiveHashTable<T, Traits>::find(const KeyType& key) const
+{
+	if (m_BucketCount == 0)
+		return NULL;
+
+	size_t hash = Traits::Hash(key);
+	for (HashTableElement* node = GetBucket(hash); node != NULL; node = node->m_NextInBucket)
+	{
+		if (node->m_Hash == hash && Traits::Equal(Traits::GetKey(static_cast<const T&>(*node)), key))
+			return static_cast<T*>(node);
+	}
+	return NULL;
+}
+
+template <class T, class Traits>
+bool IntrusiveHashTable<T, Traits>::erase(T& element)
+{
+	HashTableElement& node = element;
+	if (m_BucketCount == 0)
+		return false;
+
+	for (HashTableElement** link = &GetBucket(node.m_Hash); *link != NULL; link = &(*link)->m_NextInBucket)
+	{
+		if (*link == &node)
+		{
+			*link = node.m_NextInBucket;
+			node.m_NextInBucket = NULL;
+			node.SetTable(NULL);
+			m_Size--;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T, class Traits>
+void IntrusiveHashTable<T, Traits>::clear()
+{
+	for (size_t i = 0; i < m_BucketCount; i++)
+	{
+		HashTableElement* node = m_Buckets[i];
+		while (node != NULL)
+		{
+			HashTableElement* next = node->m_NextInBucket;
+			node->m_NextInBucket = NULL;
+			node->SetTable(NULL);
+			node = next;
+		}
+		m_Buckets[i] = NULL;
+	}
+	m_Size = 0;
+}
+
+#endif
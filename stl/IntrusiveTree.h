@@ -0,0 +1,376 @@
+#ifndef INTRUSIVE_TREE_H
+#define INTRUSIVE_TREE_H
+
+#include <algorithm>
+
+#if !UNITY_RELEASE
+#define INTRUSIVE_TREE_ASSERT(x) Assert(x)
+#else
+#define INTRUSIVE_TREE_ASSERT(x)
+#endif
+
+// Sorted AVL tree of objects that embed their own links, like List does for ListElement.
+// insert, erase and find are O(log n) and never allocate, so the tree can be used inside allocators.
+// Iteration is in key order.
+//
+// Traits provides:
+//   typedef ... KeyType;
+//   static KeyType GetKey(const T& element);
+//   static bool Less(const KeyType& a, const KeyType& b);
+//
+// Keys may be inserted more than once, equal keys are iterated in insertion order.
+
+class TreeElement
+{
+public:
+	TreeElement() : m_Left(NULL), m_Right(NULL), m_Parent(NULL), m_Height(0) {}
+	~TreeElement() { INTRUSIVE_TREE_ASSERT(!IsInTree()); }
+
+	bool IsInTree() const { return m_Height != 0; }
+
+	// Check against NULL, the tree has no end node
+	inline TreeElement* GetNext() const;
+	inline TreeElement* GetPrev() const;
+
+private:
+	// Non copyable
+	TreeElement(const TreeElement&);
+	TreeElement& operator=(const TreeElement&);
+
+	TreeElement*	m_Left;
+	TreeElement*	m_Right;
+	TreeElement*	m_Parent;
+	int				m_Height; // 0 while not in a tree, 1 for a leaf
+
+	template <class T, class Traits> friend class IntrusiveTree;
+};
+
+template <class T>
+class IntrusiveTreeIterator
+{
+public:
+	IntrusiveTreeIterator(TreeElement* node = NULL) : m_Node(node) {}
+
+	IntrusiveTreeIterator& operator++()    { m_Node = m_Node->GetNext(); return *this; }
+	IntrusiveTreeIterator  operator++(int) { IntrusiveTreeIterator ret(*this); ++(*this); return ret; }
+
+	T& operator*() const  { return static_cast<T&>(*m_Node); }
+	T* operator->() const { return static_cast<T*>(m_Node); }
+
+	friend bool operator !=(const IntrusiveTreeIterator& x, const IntrusiveTreeIterator& y) { return x.m_Node != y.m_Node; }
+	friend bool operator ==(const IntrusiveTreeIterator& x, const IntrusiveTreeIterator& y) { return x.m_Node == y.m_Node; }
+
+private:
+	TreeElement* m_Node;
+};
+
+template <class T, class Traits>
+class IntrusiveTree
+{
+public:
+	typedef IntrusiveTreeIterator<T> iterator;
+	typedef typename Traits::KeyType KeyType;
+
+	IntrusiveTree() : m_Root(NULL), m_Size(0) {}
+	~IntrusiveTree() { clear(); }
+
+	inline void insert(T& element);
+	inline void erase(T& element);
+
+	// an element with key, NULL if there is none
+	inline T* find(const KeyType& key) const;
+	// first element whose key is not less than key, NULL if there is none
+	inline T* lower_bound(const KeyType& key) const;
+
+	T* front() const { return m_Root != NULL ? static_cast<T*>(Leftmost(m_Root)) : NULL; }
+	T* back() const { return m_Root != NULL ? static_cast<T*>(Rightmost(m_Root)) : NULL; }
+
+	iterator begin() const { return iterator(m_Root != NULL ? Leftmost(m_Root) : NULL); }
+	iterator end() const { return iterator(); }
+
+	size_t size() const { return m_Size; }
+	bool empty() const { return m_Root == NULL; }
+
+	// unlinks all elements
+	inline void clear();
+
+	// checks links, order and balance, for debugging
+	inline bool Validate() const;
+
+private:
+	// Non copyable
+	IntrusiveTree(const IntrusiveTree&);
+	IntrusiveTree& operator=(const IntrusiveTree&);
+
+	static const KeyType GetKey(const TreeElement* node) { return Traits::GetKey(static_cast<const T&>(*node)); }
+	static int Height(const TreeElement* node) { return node != NULL ? node->m_Height : 0; }
+	static void UpdateHeight(TreeElement* node) { node->m_Height = std::max(Height(node->m_Left), Height(node->m_Right)) + 1; }
+
+	static TreeElement* Leftmost(TreeElement* node) { while (node->m_Left != NULL) node = node->m_Left; return node; }
+	static TreeElement* Rightmost(TreeElement* node) { while (node->m_Right != NULL) node = node->m_Right; return node; }
+
+	inline void ReplaceChild(TreeElement* parent, TreeElement* oldChild, TreeElement* newChild);
+	inline TreeElement* RotateLeft(TreeElement* node);
+	inline TreeElement* RotateRight(TreeElement* node);
+	inline void Rebalance(TreeElement* node);
+	inline int ValidateSubtree(const TreeElement* node, const TreeElement* parent, const TreeElement* lower, const TreeElement* upper) const;
+
+	TreeElement*	m_Root;
+	size_t			m_Size;
+};
+
+
+TreeElement* TreeElement::GetNext() const
+{
+	const TreeElement* node = this;
+	if (node->m_Right != NULL)
+	{
+		node = node->m_Right;
+		while (node->m_Left != NULL)
+			node = node->m_Left;
+		return const_cast<TreeElement*>(node);
+	}
+	while (node->m_Parent != NULL && node->m_Parent->m_Right == node)
+		node = node->m_Parent;
+	return node->m_Parent;
+}
+
+TreeElement* TreeElement::GetPrev() const
+{
+	const TreeElement* node = this;
+	if (node->m_Left != NULL)
+	{
+		node = node->m_Left;
+		while (node->m_Right != NULL)
+			node = node->m_Right;
+		return const_cast<TreeElement*>(node);
+	}
+	while (node->m_Parent != NULL && node->m_Parent->m_Left == node)
+		node = node->m_Parent;
+	return node->m_Parent;
+}
+
+template <class T, class Traits>
+void IntrusiveTree<T, Traits>::insert(T& element)
+{
+	TreeElement* node = &element;
+	INTRUSIVE_TREE_ASSERT(!node->IsInTree());
+
+	const KeyType key = Traits::GetKey(element);
+	TreeElement* parent = NULL;
+	TreeElement** link = &m_Root;
+	while (*link != NULL)
+	{
+		parent = *link;
+		link = Traits::Less(key, GetKey(parent)) ? &parent->m_Left : &parent->m_Right;
+	}
+
+	node->m_Left = NULL;
+	node->m_Right = NULL;
+	node->m_Parent = parent;
+	node->m_Height = 1;
+	*link = node;
+	m_Size++;
+
+	Rebalance(parent);
+}
+
+template <class T, class Traits>
+void IntrusiveTree<T, Traits>::erase(T& element)
+{
+	TreeElement* node = &element;
+	INTRUSIVE_TREE_ASSERT(node->IsInTree());
+
+	TreeElement* rebalanceFrom;
+	if (node->m_Left == NULL || node->m_Right == NULL)
+	{
+		TreeElement* child = node->m_Left != NULL ? node->m_Left : node->m_Right;
+		ReplaceChild(node->m_Parent, node, child);
+		if (child != NULL)
+			child->m_Parent = node->m_Parent;
+		rebalanceFrom = node->m_Parent;
+	}
+	else
+	{
+		// the successor takes the place of node
+		TreeElement* successor = Leftmost(node->m_Right);
+		if (successor->m_Parent != node)
+		{
+			rebalanceFrom = successor->m_Parent;
+			ReplaceChild(successor->m_Parent, successor, successor->m_Right);
+			if (successor->m_Right != NULL)
+				successor->m_Right->m_Parent = successor->m_Parent;
+			successor->m_Right = node->m_Right;
+			successor->m_Right->m_Parent = successor;
+		}
+		else
+			rebalanceFrom = successor;
+
+		successor->m_Left = node->m_Left;
+		successor->m_Left->m_Parent = successor;
+		ReplaceChild(node->m_Parent, node, successor);
+		successor->m_Parent = node->m_Parent;
+		successor->m_Height = node->m_Height;
+	}
+
+	node->m_Left = NULL;
+	node->m_Right = NULL;
+	node->m_Parent = NULL;
+	node->m_Height = 0;
+	m_Size--;
+
+	Rebalance(rebalanceFrom);
+}
+
+template <class T, class Traits>
+T* IntrusiveTree<T, Traits>::find(const KeyType& key) const
+{
+	T* result = lower_bound(key);
+	if (result != NULL && !Traits::Less(key, Traits::GetKey(*result)))
+		return result;
+	return NULL;
+}
+
+template <class T, class Traits>
+T* IntrusiveTree<T, Traits>::lower_bound(const KeyType& key) const
+{
+	TreeElement* result = NULL;
+	TreeElement* node = m_Root;
+	while (node != NULL)
+	{
+		if (Traits::Less(GetKey(node), key))
+			node = node->m_Right;
+		else
+		{
+			result = node;
+			node = node->m_Left;
+		}
+	}
+	return static_cast<T*>(result);
+}
+
+template <class T, class Traits>
+void IntrusiveTree<T, Traits>::clear()
+{
+	// post order walk, children are unlinked before their parent
+	TreeElement* node = m_Root;
+	while (node != NULL)
+	{
+		if (node->m_Left != NULL)
+			node = node->m_Left;
+		else if (node->m_Right != NULL)
+			node = node->m_Right;
+		else
+		{
+			TreeElement* parent = node->m_Parent;
+			if (parent != NULL)
+			{
+				if (parent->m_Left == node)
+					parent->m_Left = NULL;
+				else
+					parent->m_Right = NULL;
+			}
+			node->m_Parent = NULL;
+			node->m_Height = 0;
+			node = parent;
+		}
+	}
+	m_Root = NULL;
+	m_Size = 0;
+}
+
+template <class T, class Traits>
+void IntrusiveTree<T, Traits>::ReplaceChild(TreeElement* parent, TreeElement* oldChild, TreeElement* newChild)
+{
+	if (parent == NULL)
+		m_Root = newChild;
+	else if (parent->m_Left == oldChild)
+		parent->m_Left = newChild;
+	else
+		parent->m_Right = newChild;
+}
+
+template <class T, class Traits>
+TreeElement* IntrusiveTree<T, Traits>::RotateLeft(TreeElement* node)
+{
+	TreeElement* pivot = node->m_Right;
+	node->m_Right = pivot->m_Left;
+	if (pivot->m_Left != NULL)
+		pivot->m_Left->m_Parent = node;
+	ReplaceChild(node->m_Parent, node, pivot);
+	pivot->m_Parent = node->m_Parent;
+	pivot->m_Left = node;
+	node->m_Parent = pivot;
+	UpdateHeight(node);
+	UpdateHeight(pivot);
+	return pivot;
+}
+
+template <class T, class Traits>
+TreeElement* IntrusiveTree<T, Traits>::RotateRight(TreeElement* node)
+{
+	TreeElement* pivot = node->m_Left;
+	node->m_Left = pivot->m_Right;
+	if (pivot->m_Right != NULL)
+		pivot->m_Right->m_Parent = node;
+	ReplaceChild(node->m_Parent, node, pivot);
+	pivot->m_Parent = node->m_Parent;
+	pivot->m_Right = node;
+	node->m_Parent = pivot;
+	UpdateHeight(node);
+	UpdateHeight(pivot);
+	return pivot;
+}
+
+template <class T, class Traits>
+void IntrusiveTree<T, Traits>::Rebalance(TreeElement* node)
+{
+	// walk up to the root, restoring heights and rotating where the subtrees differ by more than one
+	while (node != NULL)
+	{
+		UpdateHeight(node);
+		int balance = Height(node->m_Left) - Height(node->m_Right);
+		if (balance > 1)
+		{
+			if (Height(node->m_Left->m_Left) < Height(node->m_Left->m_Right))
+				RotateLeft(node->m_Left);
+			node = RotateRight(node);
+		}
+		else if (balance < -1)
+		{
+			if (Height(node->m_Right->m_Right) < Height(node->m_Right->m_Left))
+				RotateRight(node->m_Right);
+			node = RotateLeft(node);
+		}
+		node = node->m_Parent;
+	}
+}
+
+template <class T, class Traits>
+bool IntrusiveTree<T, Traits>::Validate() const
+{
+	return ValidateSubtree(m_Root, NULL, NULL, NULL) >= 0;
+}
+
+template <class T, class Traits>
+int IntrusiveTree<T, Traits>::ValidateSubtree(const TreeElement* node, const TreeElement* parent, const TreeElement* lower, const TreeElement* upper) const
+{
+	// returns the height, -1 if the subtree is broken.
+	// Every key has to lie between the nearest ancestors it is right and left of, lower and upper, NULL when there is none
+	if (node == NULL)
+		return 0;
+	if (node->m_Parent != parent)
+		return -1;
+	if (lower != NULL && Traits::Less(GetKey(node), GetKey(lower)))
+		return -1;
+	if (upper != NULL && Traits::Less(GetKey(upper), GetKey(node)))
+		return -1;
+
+	int left = ValidateSubtree(node->m_Left, node, lower, node);
+	int right = ValidateSubtree(node->m_Right, node, node, upper);
+	if (left < 0 || right < 0 || left - right > 1 || right - left > 1 || node->m_Height != std::max(left, right) + 1)
+		return -1;
+	return node->m_Height;
+}
+
+#endif
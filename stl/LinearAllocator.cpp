@@ -2,6 +2,7 @@
 #include "UnityConfigure.h"
 #include "LinearAllocator.h"
 
+ForwardLinearAllocator g_ForwardFrameAllocator (64 * 1024, MemLabelId(kMemDefaultId, NULL));
 
 #if 0
 
@@ -16,7 +17,7 @@ struct FwdAllocatorMarker {
 
 void TestLinearAllocator ()
 {
-	ForwardLinearAllocator la (32);
+	ForwardLinearAllocator la (32, kMemDefault);
 
 	void* p0 = la.allocate (16);
 	void* p1 = la.allocate (16);
@@ -36,3 +37,35 @@ void TestLinearAllocator ()
 	la.rewind (c1);
 }
 #endif
+
+#if ENABLE_UNIT_TESTS && ENABLE_MEMORY_MANAGER
+
+#include "MemoryManager.h"
+
+void TestForwardFrameAllocator ()
+{
+	// every frame allocates more than one block, frame maintenance hands all of it back
+	GetMemoryManager().FrameMaintenance(false);
+	void* firstOfFrame = NULL;
+	for (int frame = 0; frame < 8; frame++)
+	{
+		AssertMsg(g_ForwardFrameAllocator.GetAllocatedBytes() == 0, "frame %d starts with allocations of the last frame", frame);
+
+		void* first = g_ForwardFrameAllocator.allocate (200, 16);
+		for (int i = 0; i < 1000; i++)
+			memset (g_ForwardFrameAllocator.allocate (200, 16), frame, 200);
+		AssertMsg(g_ForwardFrameAllocator.GetAllocatedBytes() >= 1001 * 200, "frame %d allocations", frame);
+		AssertMsg(g_ForwardFrameAllocator.belongs (first), "first allocation of frame %d", frame);
+
+		// the blocks of the last frame are reused instead of allocating new ones
+		AssertMsg(frame == 0 || first == firstOfFrame, "frame %d didn't reuse the purged blocks", frame);
+		firstOfFrame = first;
+
+		GetMemoryManager().FrameMaintenance(false);
+	}
+
+	GetMemoryManager().FrameMaintenance(true);
+	AssertMsg(g_ForwardFrameAllocator.GetAllocatedBytes() == 0 && g_ForwardFrameAllocator.current () == NULL, "cleanup releases everything");
+}
+
+#endif
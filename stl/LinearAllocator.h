@@ -2,7 +2,6 @@
 #define LINEAR_ALLOCATOR_H_
 
 #include <cstddef>
-#include <list>
 #include "assert.h"
 #include "UnityConfigure.h"
 #include "LogAssert.h"
@@ -18,21 +17,24 @@
 #endif
 #include "MemoryMacros.h"
 #define Assert(x)
+// Blocks are chained through a header at their start, newest first. Blocks of the default
+// size are kept in a free list when released by purge or rewind, and reused for the next
+// blocks instead of going back to the heap. purge (true) releases everything.
 struct LinearAllocatorBase
 {
 	static const int	kMinimalAlign = 4;
 		
 	struct Block
 	{
+		Block*	m_Prev;
 		char*	m_Begin;
 		char*	m_Current;
 		size_t	m_Size;
-		MemLabelId m_Label;
 		
-		void initialize (size_t size, MemLabelId label)
+		void initialize (char* begin, size_t size)
 		{
-			m_Label = label;
-			m_Current = m_Begin = (char*)UNITY_MALLOC(label,size);
+			m_Prev = NULL;
+			m_Current = m_Begin = begin;
 			m_Size = size;
 		}
 		
@@ -41,11 +43,6 @@ struct LinearAllocatorBase
 			m_Current = m_Begin;
 		}
 		
-		void purge ()
-		{
-			UNITY_FREE(m_Label, m_Begin);
-		}
-		
 		size_t used () const
 		{
 			return m_Current - m_Begin;
@@ -81,62 +78,65 @@ struct LinearAllocatorBase
 			m_Current -= size;
 		}
 		
-		bool belongs (const void* p)
+		bool belongs (const void* p) const
 		{
-			//if (p >= m_Begin && p <= m_Begin + m_Size)
-			//	return true;
-			//return false;
-
-			//return p >= m_Begin && p <= m_Begin + m_Size;
-
 			return (uintptr_t)p - (uintptr_t)m_Begin <= (uintptr_t)m_Size;
 		}
 
 		void set (void* p)
 		{
-			Assert (p >= m_Begin && p < m_Begin + m_Size);
+			Assert (p >= m_Begin && p <= m_Begin + m_Size);
 			m_Current = (char*)p;
 		}
 	};
-	
-	typedef std::list<Block, STL_ALLOCATOR(kMemPoolAlloc, Block) >	block_container;
+
+	// keeps the block memory aligned after the header
+	enum { kBlockHeaderSize = (sizeof(Block) + 15) & ~15 };
 	
 	LinearAllocatorBase (size_t blockSize, MemLabelId label)
-	:	m_Blocks(), m_BlockSize (blockSize), m_AllocLabel (label)
+	:	m_Blocks(NULL), m_FreeBlocks(NULL), m_BlockSize (blockSize), m_AllocLabel (label)
 	{
 	}
 	
 	void add_block (size_t size)
 	{
-		m_Blocks.push_back (Block());
-		size_t blockSize = size > m_BlockSize ? size : m_BlockSize;
-		m_Blocks.back ().initialize (blockSize, m_AllocLabel);
+		Block* block;
+		if (size <= m_BlockSize && m_FreeBlocks != NULL)
+		{
+			block = m_FreeBlocks;
+			m_FreeBlocks = block->m_Prev;
+			block->reset ();
+		}
+		else
+		{
+			size_t blockSize = size > m_BlockSize ? size : m_BlockSize;
+			block = (Block*)UNITY_MALLOC(m_AllocLabel, kBlockHeaderSize + blockSize);
+			block->initialize ((char*)block + kBlockHeaderSize, blockSize);
+		}
+		block->m_Prev = m_Blocks;
+		m_Blocks = block;
 	}
 	
 	void purge (bool releaseAllBlocks = false)
 	{
-		if (m_Blocks.empty ())
-			return;
-			
-		block_container::iterator begin = m_Blocks.begin ();
-			
-		if (!releaseAllBlocks)
-			begin++;
-			
-		for (block_container::iterator it = begin, end = m_Blocks.end (); it != end; ++it)
-			it->purge ();
+		release_blocks (NULL);
 
-		m_Blocks.erase (begin, m_Blocks.end ());
-
-		if (!releaseAllBlocks)
-			m_Blocks.back ().reset ();
+		if (releaseAllBlocks)
+		{
+			while (m_FreeBlocks != NULL)
+			{
+				Block* prev = m_FreeBlocks->m_Prev;
+				UNITY_FREE(m_AllocLabel, m_FreeBlocks);
+				m_FreeBlocks = prev;
+			}
+		}
 	}
 	
-	bool belongs (const void* p)
+	bool belongs (const void* p) const
 	{
-		for (block_container::iterator it = m_Blocks.begin (), end = m_Blocks.end (); it != end; ++it)
+		for (const Block* block = m_Blocks; block != NULL; block = block->m_Prev)
 		{
-			if (it->belongs (p))
+			if (block->belongs (p))
 				return true;
 		}
 		
@@ -145,30 +145,51 @@ struct LinearAllocatorBase
 
 	void* current () const
 	{
-		return m_Blocks.empty () ? 0 : m_Blocks.back ().current ();
+		return m_Blocks == NULL ? 0 : m_Blocks->current ();
 	}
 
+	// only walks the blocks allocated after mark, which are released anyway
 	void rewind (void* mark)
 	{
-		for (block_container::iterator it = m_Blocks.end (); it != m_Blocks.begin (); --it)
-		{
-			block_container::iterator tit = it;
-			--tit;
+		Block* block = m_Blocks;
+		while (block != NULL && !block->belongs (mark))
+			block = block->m_Prev;
 
-			if (tit->belongs (mark)) {
-				tit->set (mark);
+		release_blocks (block);
+		if (block != NULL)
+			block->set (mark);
+	}
 
-				for (block_container::iterator temp = it; temp != m_Blocks.end (); ++temp)
-					temp->purge ();
-				
-				m_Blocks.erase (it, m_Blocks.end ());
-				break;
-			}
-		}
+	size_t GetAllocatedBytes() const
+	{
+		size_t s = 0;
+		for (const Block* block = m_Blocks; block != NULL; block = block->m_Prev)
+			s += block->used();
+		return s;
 	}
 	
 protected:
-	block_container	m_Blocks;
+	// releases all blocks newer than 'last'
+	void release_blocks (Block* last)
+	{
+		while (m_Blocks != last)
+		{
+			Block* block = m_Blocks;
+			m_Blocks = block->m_Prev;
+
+			// oversized blocks go back to the heap
+			if (block->m_Size == m_BlockSize)
+			{
+				block->m_Prev = m_FreeBlocks;
+				m_FreeBlocks = block;
+			}
+			else
+				UNITY_FREE(m_AllocLabel, block);
+		}
+	}
+
+	Block*			m_Blocks;
+	Block*			m_FreeBlocks;
 	size_t			m_BlockSize;	
 	MemLabelId      m_AllocLabel;
 };
@@ -206,14 +227,6 @@ struct ForwardLinearAllocator : public LinearAllocatorBase
 		purge (true);
 	}
 
-	size_t GetAllocatedBytes() const
-	{
-		size_t s = 0;
-		for (block_container::const_iterator it = m_Blocks.begin (); it != m_Blocks.end(); ++it)
-			s += it->used();
-		return s;
-	}
-	
 	void* allocate (size_t size, size_t alignment = 4)
 	{
 #if ENABLE_THREAD_CHECK_IN_ALLOCS
@@ -222,15 +235,13 @@ struct ForwardLinearAllocator : public LinearAllocatorBase
 #endif
 //		Assert (size == AlignUIntPtr (size, kMinimalAlign));
 		
-		if (m_Blocks.empty ())
-			add_block (size);
-
-		Block* block = &m_Blocks.back ();
-		size_t padding = block->padding (alignment);
+		Block* block = m_Blocks;
+		size_t padding = block != NULL ? block->padding (alignment) : 0;
 		
-		if (size + padding > block->available ()) {
-			add_block (size);
-			block = &m_Blocks.back ();
+		if (block == NULL || size + padding > block->available ()) {
+			add_block (size + alignment);
+			block = m_Blocks;
+			padding = block->padding (alignment);
 		}
 			
 		uintptr_t p = (uintptr_t)block->bump (size + padding);
@@ -272,8 +283,9 @@ struct ForwardLinearAllocator : public LinearAllocatorBase
 
 	using LinearAllocatorBase::current;
 	using LinearAllocatorBase::belongs;
+	using LinearAllocatorBase::GetAllocatedBytes;
 };
-/*
+
 // std::allocator concept implementation for ForwardLinearAllocator objects.
 // use it to make STL use your *locally* created ForwardLinearAllocator object
 // example:
@@ -301,7 +313,7 @@ public:
 	
 	template <class U> struct rebind { typedef forward_linear_allocator<U> other; };
 	
-	forward_linear_allocator(ForwardLinearAllocator& al) throw() : m_LinearAllocator (al) {}
+	forward_linear_allocator(ForwardLinearAllocator& al) throw() : m_LinearAllocator (&al) {}
 	forward_linear_allocator(const forward_linear_allocator& al) throw() : m_LinearAllocator (al.m_LinearAllocator) {}
 	template <class U> forward_linear_allocator(const forward_linear_allocator<U>& al) throw() : m_LinearAllocator (al.m_LinearAllocator) {}
 	~forward_linear_allocator() throw() {}
@@ -310,9 +322,14 @@ public:
 	const_pointer address(const_reference x) const { return &x; }
 	
 	pointer allocate(size_type count, void const* hint = 0)
-	{ return (pointer)m_LinearAllocator.allocate (count * sizeof(T)); }
+	{ return (pointer)m_LinearAllocator->allocate (count * sizeof(T), ALIGN_OF(T)); }
 	void deallocate(pointer p, size_type n)
-	{ m_LinearAllocator.deallocate(p); }
+	{ m_LinearAllocator->deallocate(p); }
+
+	template <class U> bool operator==(forward_linear_allocator<U> const& a) const
+	{	return m_LinearAllocator == a.m_LinearAllocator; }
+	template <class U> bool operator!=(forward_linear_allocator<U> const& a) const
+	{	return m_LinearAllocator != a.m_LinearAllocator; }
 	
 	size_type max_size() const throw()
 	{	return 0x80000000; }
@@ -324,12 +341,15 @@ public:
 	{	p->~T(); }
 
 private:
-	ForwardLinearAllocator&	m_LinearAllocator;
+	template <class U> friend class forward_linear_allocator;
+	// a pointer rather than a reference, so containers can assign and swap allocators
+	ForwardLinearAllocator*	m_LinearAllocator;
 };
 
 // this a global ForwardLinearAllocator object that can be used to allocate (and release) memory from
 // anywhere in the program. Caller is responsible for tracking memory used in total
 // (use ForwardLinearAllocator::current/ForwardLinearAllocator::rewind to save and restore memory pointer)
+// MemoryManager::FrameMaintenance purges it, so nothing allocated from it survives the frame.
 extern ForwardLinearAllocator	g_ForwardFrameAllocator;
 
 // std::allocator concept for global ForwardLinearAllocator object
@@ -357,7 +377,7 @@ public:
 	const_pointer address(const_reference x) const { return &x; }
 	
 	pointer allocate(size_type count, void const* hint = 0)
-	{ return (pointer)g_ForwardFrameAllocator.allocate (count * sizeof(T)); }
+	{ return (pointer)g_ForwardFrameAllocator.allocate (count * sizeof(T), ALIGN_OF(T)); }
 	void deallocate(pointer p, size_type n)
 	{ g_ForwardFrameAllocator.deallocate(p); }
 
@@ -378,15 +398,14 @@ public:
 
 #define DECLARE_GLOBAL_LINEAR_ALLOCATOR_MEMBER_NEW_DELETE \
 public:	\
-	inline void* operator new( size_t size ) { return g_ForwardFrameAllocator.allocate(size); } \
+	inline void* operator new( size_t size ) { return g_ForwardFrameAllocator.allocate(size, kDefaultMemoryAlignment); } \
 	inline void	operator delete( void* p ) { g_ForwardFrameAllocator.deallocate(p); }
 
-inline void* operator new (size_t size, ForwardLinearAllocator& al) { return al.allocate (size); }
-inline void* operator new [] (size_t size, ForwardLinearAllocator& al) { return al.allocate (size); }
+inline void* operator new (size_t size, ForwardLinearAllocator& al) { return al.allocate (size, kDefaultMemoryAlignment); }
+inline void* operator new [] (size_t size, ForwardLinearAllocator& al) { return al.allocate (size, kDefaultMemoryAlignment); }
 
 inline void operator delete (void* p, ForwardLinearAllocator& al) { }
 inline void operator delete [] (void* p, ForwardLinearAllocator& al) { }
-*/
 
 
 #endif
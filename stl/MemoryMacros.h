@@ -39,6 +39,16 @@ enum
 #endif
 };
 
+// data written by different threads should be kCacheLineSize apart, so the threads don't invalidate each other's cache lines
+enum
+{
+#if UNITY_XENON || UNITY_PS3
+	kCacheLineSize = 128
+#else
+	kCacheLineSize = 64
+#endif
+};
+
 enum
 {
 	kAllocateOptionNone = 0,						// Fatal: Show message box with out of memory error and quit application
@@ -102,6 +102,9 @@ void operator delete [] (void* p, MemLabelRef label, bool /*set_root*/, int /*al
 #include "StackAllocator.h"
 #include "TLSAllocator.h"
 #include "DualThreadAllocator.h"
+#include "FrameAllocator.h"
+#include "LinearAllocator.h"
+#include "RegionAllocator.h"
 #include "Thread.h"
 #include "Allocator.h"
 #include "Word.h"
@@ -154,6 +157,21 @@ static size_t kTempAllocatorMainSize = 512*1024;
 static size_t kTempAllocatorThreadSize = 64*1024;
 #endif
 
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE && UNITY_64
+// temp allocators reserve this much address space and commit it on demand, so they don't spill
+static size_t kTempAllocatorReserveSize = 64*1024*1024;
+#else
+static size_t kTempAllocatorReserveSize = 0;
+#endif
+
+// kMemFrameTemp allocations live for two frames
+static const int kFrameAllocatorFrameCount = 2;
+#if UNITY_EDITOR
+static size_t kFrameAllocatorChunkSize = 1024*1024;
+#else
+static size_t kFrameAllocatorChunkSize = 256*1024;
+#endif
+
 #if ENABLE_MEMORY_MANAGER
 
 
@@ -354,6 +372,11 @@ inline void MemoryManager::CheckDisalowAllocation()
 MemoryManager::MemoryManager()
 : m_NumAllocators(0)
 , m_FrameTempAllocator(NULL)
+, m_FrameAllocator(NULL)
+, m_ShortLivedAllocator(NULL)
+, m_NumRegionAllocators(0)
+, m_RegionLowestAddress((size_t)-1)
+, m_RegionHighestAddress(0)
 , m_IsInitialized(false)
 , m_IsActive(true)
 {
@@ -364,7 +387,11 @@ MemoryManager::MemoryManager()
 	memset (m_Allocators, 0, sizeof(m_Allocators));
 	memset (m_MainAllocators, 0, sizeof(m_MainAllocators));
 	memset (m_ThreadAllocators, 0, sizeof(m_ThreadAllocators));
+	memset (m_RegionAllocators, 0, sizeof(m_RegionAllocators));
 	memset (m_AllocatorMap, 0, sizeof(m_AllocatorMap));
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	m_ShortLivedSegregation = true;
+#endif
 
 	// Main thread will not have a valid TLSAlloc until ThreadInitialize() is called!
 #if UNITY_FLASH || UNITY_WEBGL
@@ -397,6 +424,7 @@ void MemoryManager::StaticDestroy()
 void MemoryManager::InitializeMainThreadAllocators()
 {
 	m_FrameTempAllocator = HEAP_NEW(TempTLSAllocator)("ALLOC_TEMP_THREAD");
+	m_FrameAllocator = HEAP_NEW(FrameAllocator)(kFrameAllocatorChunkSize, kFrameAllocatorFrameCount, "ALLOC_FRAME");
 
 #if (UNITY_WIN && !UNITY_WP8) || UNITY_OSX
 	BaseAllocator* defaultThreadAllocator = NULL;
@@ -413,6 +441,7 @@ void MemoryManager::InitializeMainThreadAllocators()
 		m_AllocatorMap[i].alloc = defaultAllocator;
 
 	m_AllocatorMap[kMemTempAllocId].alloc = m_FrameTempAllocator;
+	m_AllocatorMap[kMemFrameTempId].alloc = m_FrameAllocator;
     m_AllocatorMap[kMemStaticStringId].alloc = m_InitialFallbackAllocator;
 
 #if UNITY_IPHONE
@@ -546,6 +575,11 @@ void MemoryManager::InitializeMainThreadAllocators()
 
 #endif
 
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	// allocations predicted to be short lived get pools of their own, so they don't keep the pools of long lived ones alive
+	m_ShortLivedAllocator = m_Allocators[m_NumAllocators++] = HEAP_NEW(DynamicHeapAllocator<LowLevelAllocator>)(1024*1024, 0, true, "ALLOC_SHORTLIVED");
+#endif
+
 	m_IsInitialized = true;
 	m_IsActive = true;
 
@@ -594,6 +628,8 @@ MemoryManagerAutoDestructor g_MemoryManagerAutoDestructor;
 MemoryManager::MemoryManager()
 : m_NumAllocators(0)
 , m_FrameTempAllocator(NULL)
+, m_FrameAllocator(NULL)
+, m_ShortLivedAllocator(NULL)
 {
 }
 
@@ -675,7 +711,7 @@ void MemoryManager::ThreadInitialize(size_t tempSize)
 	if(tempSize != 0)
 		tempAllocatorSize = tempSize;
 
-	StackAllocator* tempAllocator = UNITY_NEW(StackAllocator(tempAllocatorSize, "ALLOC_TEMP_THREAD"), kMemManager);
+	StackAllocator* tempAllocator = UNITY_NEW(StackAllocator(tempAllocatorSize, "ALLOC_TEMP_THREAD", kTempAllocatorReserveSize), kMemManager);
 	m_FrameTempAllocator->ThreadInitialize(tempAllocator);
 }
 
@@ -735,7 +771,31 @@ void* MemoryManager::Allocate(size_t size, int align, MemLabelRef label, int all
 		return Allocate(size, align, kMemDefault, allocateOptions, file, line);
 	}
 
+	if (IsFrameAllocatorLabel(label))
+	{
+		// not registered with the memory profiler, the allocations are never freed one by one.
+		// Allocations that don't fit into a chunk get one of their own, released with their frame.
+		void* ptr = m_FrameAllocator->Allocate(size, align);
+		if (!(allocateOptions & kAllocateOptionReturnNullIfOutOfMemory))
+			CheckAllocation(ptr, size, align, label, file, line);
+		return ptr;
+	}
+
+	BaseAllocator* region = RegionAllocatorScope::GetActiveRegion(label);
+	if (region)
+	{
+		// released in bulk, so not registered with the memory profiler either
+		void* ptr = region->Allocate(size, align);
+		if (!(allocateOptions & kAllocateOptionReturnNullIfOutOfMemory))
+			CheckAllocation(ptr, size, align, label, file, line);
+		return ptr;
+	}
+
 	BaseAllocator* alloc = GetAllocator(label);
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	if (IsShortLivedAllocation(label, file, line))
+		alloc = m_ShortLivedAllocator;
+#endif
 	CheckDisalowAllocation();
 
 	void* ptr = alloc->Allocate(size, align);
@@ -772,6 +832,7 @@ void MemoryManager::ThreadCleanup()
 {
 	for(int i = 0; i < m_NumAllocators; i++)
 		m_Allocators[i]->ThreadCleanup();
+	ConcurrentLinearAllocator::ReleaseThreadSlot();
 
 	if(Thread::CurrentThreadIsMainThread())
 	{
@@ -781,6 +842,10 @@ void MemoryManager::ThreadCleanup()
 		m_IsActive = false;
 
 #if !UNITY_EDITOR
+		HEAP_DELETE(m_FrameAllocator, BaseAllocator);
+		m_FrameAllocator = NULL;
+		m_ShortLivedAllocator = NULL;
+
 		for(int i = 0; i < m_NumAllocators; i++)
 		{
 			HEAP_DELETE(m_Allocators[i], BaseAllocator);
@@ -814,6 +879,15 @@ void MemoryManager::ThreadCleanup()
 void MemoryManager::FrameMaintenance(bool cleanup)
 {
 	m_FrameTempAllocator->FrameMaintenance(cleanup);
+	// retires the oldest kMemFrameTemp buffer
+	if(m_FrameAllocator)
+		m_FrameAllocator->FrameMaintenance(cleanup);
+	// g_ForwardFrameAllocator allocations only live until the end of the frame
+	g_ForwardFrameAllocator.purge(cleanup);
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	if(GetMemoryProfiler())
+		GetMemoryProfiler()->FrameMaintenance();
+#endif
 	for(int i = 0; i < m_NumAllocators; i++)
 		m_Allocators[i]->FrameMaintenance(cleanup);
 }
@@ -903,7 +977,29 @@ void* MemoryManager::Reallocate(void* ptr, size_t size, int align, MemLabelRef l
 		return Reallocate( ptr, size, align, kMemDefault, allocateOptions, file, line);
 	}
 
+	if (IsFrameAllocatorLabel(label) && (ptr == NULL || m_FrameAllocator->Contains(ptr)))
+	{
+		// the old block is released with its frame
+		void* newptr = m_FrameAllocator->Reallocate(ptr, size, align);
+		if (!(allocateOptions & kAllocateOptionReturnNullIfOutOfMemory))
+			CheckAllocation(newptr, size, align, label, file, line);
+		return newptr;
+	}
+
+	BaseAllocator* region = RegionAllocatorScope::GetActiveRegion(label);
+	if (region && (ptr == NULL || region->Contains(ptr)))
+	{
+		void* newptr = region->Reallocate(ptr, size, align);
+		if (!(allocateOptions & kAllocateOptionReturnNullIfOutOfMemory))
+			CheckAllocation(newptr, size, align, label, file, line);
+		return newptr;
+	}
+
 	BaseAllocator* alloc = GetAllocator(label);
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	if (ptr == NULL ? IsShortLivedAllocation(label, file, line) : m_ShortLivedAllocator->Contains(ptr))
+		alloc = m_ShortLivedAllocator;
+#endif
 	CheckDisalowAllocation();
 
 	if(ptr != NULL && !alloc->Contains(ptr))
@@ -958,7 +1054,21 @@ void MemoryManager::Deallocate(void* ptr, MemLabelRef label)
 		return Deallocate(ptr);
 	}
 
+	if (m_NumRegionAllocators != 0)
+	{
+		BaseAllocator* region = GetRegionAllocatorContainingPtr(ptr);
+		if (region)
+			return region->Deallocate(ptr);
+	}
+
+	if (IsFrameAllocatorLabel(label) && m_FrameAllocator->Contains(ptr))
+		return;
+
 	BaseAllocator* alloc = GetAllocator(label);
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	if (m_ShortLivedAllocator->Contains(ptr))
+		alloc = m_ShortLivedAllocator;
+#endif
 	CheckDisalowAllocation();
 
 	if(!alloc->Contains(ptr))
@@ -980,13 +1090,20 @@ void MemoryManager::Deallocate(void* ptr)
 	if (ptr == NULL)
 		return;
 
+	if (m_NumRegionAllocators != 0)
+	{
+		BaseAllocator* region = GetRegionAllocatorContainingPtr(ptr);
+		if (region)
+			return region->Deallocate(ptr);
+	}
+
 	BaseAllocator* alloc = GetAllocatorContainingPtr(ptr);
 
 	if (alloc)
 	{
 		Assert (alloc != m_FrameTempAllocator);
 #if ENABLE_MEM_PROFILER
-		if(GetMemoryProfiler() && alloc != m_InitialFallbackAllocator)
+		if(GetMemoryProfiler() && alloc != m_InitialFallbackAllocator && alloc != m_FrameAllocator)
 		{
 			size_t oldsize = alloc->GetPtrSize(ptr);
 			GetMemoryProfiler()->UnregisterAllocation(ptr, alloc, oldsize, NULL, kMemDefault);
@@ -1083,6 +1200,13 @@ BaseAllocator* MemoryManager::GetAllocatorContainingPtr(const void* ptr)
 	if(m_FrameTempAllocator && m_FrameTempAllocator->Contains(ptr))
 		return m_FrameTempAllocator;
 
+	if(m_FrameAllocator && m_FrameAllocator->Contains(ptr))
+		return m_FrameAllocator;
+
+	BaseAllocator* region = GetRegionAllocatorContainingPtr(ptr);
+	if(region)
+		return region;
+
 	for(int i = 0; i < m_NumAllocators ; i++)
 	{
 		if(m_Allocators[i]->IsAssigned() && m_Allocators[i]->Contains(ptr))
@@ -1141,6 +1265,68 @@ void MemoryManager::RemoveCustomAllocator(BaseAllocator* allocator)
 		UNITY_DELETE(g_CustomAllocators, kMemDefault);
 }
 
+// guards m_RegionAllocators and the region address range. Taken before a region's own lock.
+static Mutex g_RegionAllocatorLock;
+
+bool MemoryManager::AddRegionAllocator(BaseAllocator* region)
+{
+	Mutex::AutoLock autolock(g_RegionAllocatorLock);
+	if (m_NumRegionAllocators == kMaxRegionAllocators)
+	{
+		ErrorStringMsg("Too many region allocators, '%s' can't allocate", region->GetName());
+		return false;
+	}
+	m_RegionAllocators[m_NumRegionAllocators] = region;
+	AtomicIncrement(&m_NumRegionAllocators);
+	return true;
+}
+
+void MemoryManager::RemoveRegionAllocator(BaseAllocator* region)
+{
+	Mutex::AutoLock autolock(g_RegionAllocatorLock);
+	for (int i = 0; i < m_NumRegionAllocators; i++)
+	{
+		if (m_RegionAllocators[i] == region)
+		{
+			m_RegionAllocators[i] = m_RegionAllocators[m_NumRegionAllocators - 1];
+			AtomicDecrement(&m_NumRegionAllocators);
+			break;
+		}
+	}
+
+	if (m_NumRegionAllocators == 0)
+	{
+		m_RegionLowestAddress = (size_t)-1;
+		m_RegionHighestAddress = 0;
+	}
+}
+
+void MemoryManager::AddRegionAddressRange(const void* begin, const void* end)
+{
+	Mutex::AutoLock autolock(g_RegionAllocatorLock);
+	if ((size_t)begin < m_RegionLowestAddress)
+		m_RegionLowestAddress = (size_t)begin;
+	if ((size_t)end > m_RegionHighestAddress)
+		m_RegionHighestAddress = (size_t)end;
+}
+
+BaseAllocator* MemoryManager::GetRegionAllocatorContainingPtr(const void* ptr)
+{
+	// Most frees are outside of every region and don't take the lock. A pointer a region handed out
+	// was reported before it was returned, so it can't be rejected here.
+	if ((size_t)ptr < m_RegionLowestAddress || (size_t)ptr >= m_RegionHighestAddress)
+		return NULL;
+
+	// regions may be removed by other threads while we look
+	Mutex::AutoLock autolock(g_RegionAllocatorLock);
+	for (int i = 0; i < m_NumRegionAllocators; i++)
+	{
+		if (m_RegionAllocators[i]->Contains(ptr))
+			return m_RegionAllocators[i];
+	}
+	return NULL;
+}
+
 BaseAllocator* MemoryManager::GetAllocatorAtIndex( int index )
 {
 	return m_Allocators[index];
@@ -1179,6 +1365,8 @@ int MemoryManager::GetAllocatorIndex( BaseAllocator* alloc )
 size_t MemoryManager::GetTotalAllocatedMemory()
 {
 	size_t total = m_FrameTempAllocator->GetAllocatedMemorySize();
+	if(m_FrameAllocator)
+		total += m_FrameAllocator->GetAllocatedMemorySize();
 	for(int i = 0; i < m_NumAllocators ; i++)
 		total += m_Allocators[i]->GetAllocatedMemorySize();
 	return total;
@@ -1187,6 +1375,8 @@ size_t MemoryManager::GetTotalAllocatedMemory()
 size_t MemoryManager::GetTotalReservedMemory()
 {
 	size_t total = m_FrameTempAllocator->GetReservedSizeTotal();
+	if(m_FrameAllocator)
+		total += m_FrameAllocator->GetReservedSizeTotal();
 	for(int i = 0; i < m_NumAllocators ; i++)
 		total += m_Allocators[i]->GetReservedSizeTotal();
 	return total;
@@ -1245,7 +1435,7 @@ void MemoryManager::RegisterAllocation(void* ptr, size_t size, BaseAllocator* al
 			m_AllocatorMap[label.label].numAllocs++;
 			m_AllocatorMap[label.label].largestAlloc = std::max(m_AllocatorMap[label.label].largestAlloc, size);
 		}
-		GetMemoryProfiler()->RegisterAllocation(ptr, label, file, line, size);
+		GetMemoryProfiler()->RegisterAllocation(ptr, alloc, label, file, line, size);
 		if (m_LogAllocations && size >= m_LogAllocationsThreshold)
 		{
 			size_t totalAllocatedMemoryAfterAllocation = GetTotalAllocatedMemory();
@@ -1256,6 +1446,18 @@ void MemoryManager::RegisterAllocation(void* ptr, size_t size, BaseAllocator* al
 	}
 }
 
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+bool MemoryManager::IsShortLivedAllocation(MemLabelRef label, const char* file, int line)
+{
+	// the profiler's own allocations are not predicted, they happen while it is learning
+	if (!m_ShortLivedSegregation || m_ShortLivedAllocator == NULL || GetMemoryProfiler() == NULL || file == NULL || label.label >= kMemLabelCount)
+		return false;
+	if (label.label == kMemProfilerId || label.label == kMemMemoryProfilerId || label.label == kMemMemoryProfilerStringId)
+		return false;
+	return GetMemoryProfiler()->IsShortLivedAllocationSite(label, file, line);
+}
+#endif
+
 ProfilerAllocationHeader* MemoryManager::RegisterDeallocation(void* ptr, BaseAllocator* alloc, MemLabelRef label, const char* function)
 {
 	ProfilerAllocationHeader* relatedHeader = NULL;
@@ -1315,7 +1517,7 @@ int catchMemoryAllocHook(int allocType, void *userData, size_t size, int blockTy
 #endif
 	}
 	else
-		GetMemoryProfiler()->RegisterAllocation(NULL, MemLabelId(kMemLabelCount, NULL), NULL, 0, size);
+		GetMemoryProfiler()->RegisterAllocation(NULL, NULL, MemLabelId(kMemLabelCount, NULL), NULL, 0, size);
 	return TRUE;
 }
 
@@ -40,8 +40,20 @@ public:
 	MemLabelId AddCustomAllocator(BaseAllocator* allocator);
 	void RemoveCustomAllocator(BaseAllocator* allocator);
 
+	// region allocators register themselves, so their pointers can be freed with any label.
+	// Fails when kMaxRegionAllocators are registered, the region must not allocate then.
+	bool AddRegionAllocator(BaseAllocator* region);
+	void RemoveRegionAllocator(BaseAllocator* region);
+	// memory a region allocator got, frees outside of all reported ranges skip the region lookup
+	void AddRegionAddressRange(const void* begin, const void* end);
+
 	void FrameMaintenance(bool cleanup = false);
 
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	// on by default. Switched off, every allocation goes to the allocator of its label again, for comparisons
+	void SetShortLivedSegregation(bool enable) { m_ShortLivedSegregation = enable; }
+#endif
+
 	static void* LowLevelAllocate( size_t size );
 	static void* LowLevelCAllocate( size_t count, size_t size );
 	static void* LowLevelReallocate( void* p, size_t size );
@@ -78,6 +90,8 @@ public:
 	BaseAllocator* GetAllocatorContainingPtr(const void* ptr);
 
 	static inline bool IsTempAllocatorLabel( MemLabelRef label ) { return label.label == kMemTempAllocId; }
+	// kMemFrameTemp allocations stay valid until the end of the next frame, freeing them is optional
+	static inline bool IsFrameAllocatorLabel( MemLabelRef label ) { return label.label == kMemFrameTempId; }
 
 	volatile static long m_LowLevelAllocated;
 	volatile static long m_RegisteredGfxDriverMemory;
@@ -86,22 +100,38 @@ private:
 #if ENABLE_MEM_PROFILER
 	void RegisterAllocation(void* ptr, size_t size, BaseAllocator* alloc, MemLabelRef label, const char* function, const char* file, int line);
 	ProfilerAllocationHeader* RegisterDeallocation(void* ptr, BaseAllocator* alloc, MemLabelRef label, const char* function);
+#endif
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	bool IsShortLivedAllocation(MemLabelRef label, const char* file, int line);
 #endif
 	void InitializeMainThreadAllocators();
+	BaseAllocator* GetRegionAllocatorContainingPtr(const void* ptr);
 
 	static const int kMaxAllocators = 16;
+	static const int kMaxRegionAllocators = 16;
 
 	BaseAllocator*   m_FrameTempAllocator;
+	BaseAllocator*   m_FrameAllocator;
+	BaseAllocator*   m_ShortLivedAllocator;
 	BaseAllocator*   m_InitialFallbackAllocator;
 
 	BaseAllocator*   m_Allocators[kMaxAllocators];
 	BaseAllocator*   m_MainAllocators[kMaxAllocators];
 	BaseAllocator*   m_ThreadAllocators[kMaxAllocators];
 
+	BaseAllocator*   m_RegionAllocators[kMaxRegionAllocators];
+	volatile int     m_NumRegionAllocators;
+	// covers every chunk the registered regions got, only shrinks when the last region goes away
+	volatile size_t  m_RegionLowestAddress;
+	volatile size_t  m_RegionHighestAddress;
+
 	int              m_NumAllocators;
 	bool             m_LogAllocations;
 	bool             m_IsInitialized;
 	bool             m_IsActive;
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	bool             m_ShortLivedSegregation;
+#endif
 
 
 	size_t           m_LogAllocationsThreshold;
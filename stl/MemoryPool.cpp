@@ -4,6 +4,10 @@
 #include "MemoryProfiler.h"
 #include "InitializeAndCleanup.h"
 #include "LogAssert.h"
+#include "AtomicOps.h"
+#include "BitUtility.h"
+#include <algorithm>
+#include <functional>
 
 static int kMinBlockSize = sizeof(void*);
 UNITY_VECTOR(kMemPoolAlloc,MemoryPool*)* MemoryPool::s_MemoryPools = NULL;
@@ -26,9 +30,23 @@ void MemoryPool::RegisterStaticMemoryPool(MemoryPool* pool)
 	s_MemoryPools->push_back(pool);
 }
 
+// keeps blocks aligned like the label allocator would
+static const int kBubbleHeaderSize = 32;
+
+int MemoryPool::GetBubbleSizeForBlockSize(int blockSize)
+{
+	// at least 128 blocks per bubble, plus room for the bubble header, in whole pages
+	const int kDefaultBubbleSize = 32 * 1024;
+	int size = std::max(blockSize, kMinBlockSize) * 128 + kBubbleHeaderSize;
+	return std::max<int>(kDefaultBubbleSize, (size + 4095) & ~4095);
+}
+// empty bubbles kept around when trimming automatically, so a pool going up and down doesn't thrash
+static const int kMaxEmptyBubbles = 1;
+
 MemoryPool::MemoryPool( bool threadCheck, const char* name, int blockSize, int hintSize, MemLabelId label )
 	: m_AllocLabel(MemLabelId(label.label, GET_CURRENT_ALLOC_ROOT_HEADER()))
 	, m_Bubbles(MemLabelId(label.label, GET_CURRENT_ALLOC_ROOT_HEADER()))
+	, m_PartialBubbles(MemLabelId(label.label, GET_CURRENT_ALLOC_ROOT_HEADER()))
 #if DEBUGMODE
 	,	m_PeakAllocCount(0)
 	,	m_Name(name)
@@ -38,22 +56,20 @@ MemoryPool::MemoryPool( bool threadCheck, const char* name, int blockSize, int h
 	m_ThreadCheck = threadCheck;
 #endif
 
+	CompileTimeAssert(sizeof(Bubble) <= kBubbleHeaderSize, "Bubble header does not fit");
+
 	if (blockSize < kMinBlockSize)
 		blockSize = kMinBlockSize;
 	m_BlockSize = blockSize;
 
-
 	m_BubbleSize = hintSize;
-	m_BlocksPerBubble = (m_BubbleSize - sizeof(Bubble) + 1) / blockSize;
-
-	int usedBubbleSize = sizeof(Bubble) + m_BlocksPerBubble * blockSize - 1;
-	Assert(usedBubbleSize <= m_BubbleSize);
-	Assert(m_BubbleSize - usedBubbleSize <= m_BlockSize);
+	m_BlocksPerBubble = (m_BubbleSize - kBubbleHeaderSize) / blockSize;
 
 	Assert (m_BlocksPerBubble >= 128);
 	Assert(hintSize % 4096 == 0);
 
 	m_AllocateMemoryAutomatically = true;
+	m_TrimAutomatically = true;
 
 	Reset();
 }
@@ -69,10 +85,9 @@ MemoryPool::~MemoryPool()
 
 void MemoryPool::Reset()
 {
-#if DEBUGMODE
 	m_AllocCount = 0;
-#endif
-	m_HeadOfFreeList = NULL;
+	m_CurrentBubble = NULL;
+	m_EmptyBubbleCount = 0;
 }
 
 void MemoryPool::DeallocateAll()
@@ -81,52 +96,132 @@ void MemoryPool::DeallocateAll()
 	for( it = m_Bubbles.begin(); it != itEnd; ++it )
 		UNITY_FREE( m_AllocLabel, *it );
 	m_Bubbles.clear();
+	m_PartialBubbles.clear();
 	Reset();
 }
 
+void MemoryPool::Trim()
+{
+	for (int i = m_Bubbles.size() - 1; i >= 0; --i)
+	{
+		Bubble* bubble = m_Bubbles[i];
+		if (bubble->liveCount == 0)
+			FreeBubble(bubble);
+	}
+}
+
 void MemoryPool::PreallocateMemory (int size)
 {
 	bool temp = m_AllocateMemoryAutomatically;
 	m_AllocateMemoryAutomatically = true;
 	for (int i=0;i <= size / (m_BlocksPerBubble * m_BlockSize);i++)
 	{
-		AllocNewBubble();
+		Bubble* bubble = AllocNewBubble();
+		if (bubble != NULL)
+			AddPartialBubble(bubble);
 	}
 	m_AllocateMemoryAutomatically = temp;
 }
 
-void MemoryPool::AllocNewBubble(  )
+inline char* MemoryPool::GetBubbleData( Bubble* bubble ) const
+{
+	return (char*)bubble + kBubbleHeaderSize;
+}
+
+MemoryPool::Bubble* MemoryPool::GetBubble( const void* ptr ) const
+{
+	// most frees go back to the bubble that is being allocated from
+	Bubble* current = m_CurrentBubble;
+	if( current != NULL && (const char*)ptr >= (const char*)current && (const char*)ptr < (const char*)current + m_BubbleSize )
+		return current;
+
+	// the last bubble that starts before ptr
+	Bubbles::const_iterator it = std::upper_bound( m_Bubbles.begin(), m_Bubbles.end(), (Bubble*)ptr, std::less<Bubble*>() );
+	AssertIf( it == m_Bubbles.begin() );
+	return *(it - 1);
+}
+
+MemoryPool::Bubble* MemoryPool::AllocNewBubble(  )
 {
 	if (!m_AllocateMemoryAutomatically)
-		return;
+		return NULL;
 
 	AssertIf (m_BlocksPerBubble == 1); // can't have 1 element per bubble
 
 	Bubble *bubble = (Bubble*)UNITY_MALLOC( m_AllocLabel, m_BubbleSize );
-	AssertIf( !bubble );
+	// still failure, error out
+	if( !bubble )
+	{
+		ErrorString( "out of memory!" );
+		return NULL;
+	}
 
-	// put to bubble list
-	m_Bubbles.push_back( bubble );
+	// put to bubble list, keeping it sorted
+	bubble->partialIndex = -1;
+	bubble->liveCount = 0;
+	Bubbles::iterator it = std::lower_bound( m_Bubbles.begin(), m_Bubbles.end(), bubble, std::less<Bubble*>() );
+	m_Bubbles.insert( it, &bubble, &bubble + 1 );
+	++m_EmptyBubbleCount;
 
 	// setup the free list inside a bubble
-	void* oldHeadOfFreeList = m_HeadOfFreeList;
-	m_HeadOfFreeList = bubble->data;
-	AssertIf( !m_HeadOfFreeList );
-
-	void **newBubble = (void**)m_HeadOfFreeList;
+	bubble->freeList = GetBubbleData(bubble);
+	void **newBubble = (void**)bubble->freeList;
 	for( int j = 0; j < m_BlocksPerBubble-1; ++j )
 	{
 		newBubble[0] = (char*)newBubble + m_BlockSize;
 		newBubble = (void**)newBubble[0];
 	}
+	newBubble[0] = NULL;
 
-	newBubble[0] = oldHeadOfFreeList; // continue with existing free list (or terminate with NULL if no free elements)
+	return bubble;
+}
 
-	// still failure, error out
-	if( !m_HeadOfFreeList )
+void MemoryPool::FreeBubble( Bubble* bubble )
+{
+	AssertIf(bubble->liveCount != 0);
+
+	if (bubble->partialIndex != -1)
+		RemovePartialBubble(bubble);
+	if (bubble == m_CurrentBubble)
+		m_CurrentBubble = NULL;
+
+	Bubbles::iterator it = std::lower_bound( m_Bubbles.begin(), m_Bubbles.end(), bubble, std::less<Bubble*>() );
+	Assert( it != m_Bubbles.end() && *it == bubble );
+	m_Bubbles.erase( it );
+
+	--m_EmptyBubbleCount;
+	UNITY_FREE( m_AllocLabel, bubble );
+}
+
+void MemoryPool::AddPartialBubble( Bubble* bubble )
+{
+	bubble->partialIndex = m_PartialBubbles.size();
+	m_PartialBubbles.push_back(bubble);
+}
+
+void MemoryPool::RemovePartialBubble( Bubble* bubble )
+{
+	Bubble* last = m_PartialBubbles.back();
+	last->partialIndex = bubble->partialIndex;
+	m_PartialBubbles[bubble->partialIndex] = last;
+	m_PartialBubbles.pop_back();
+	bubble->partialIndex = -1;
+}
+
+MemoryPool::Bubble* MemoryPool::TakeFullestPartialBubble()
+{
+	// filling up the fullest bubbles first concentrates live blocks, so that the others can run empty
+	Bubble* fullest = NULL;
+	size_t n = m_PartialBubbles.size();
+	for( size_t i = 0; i < n; ++i )
 	{
-		ErrorString( "out of memory!" );
+		Bubble* bubble = m_PartialBubbles[i];
+		if (fullest == NULL || bubble->liveCount > fullest->liveCount)
+			fullest = bubble;
 	}
+	if (fullest != NULL)
+		RemovePartialBubble(fullest);
+	return fullest;
 }
 
 void* MemoryPool::Allocate()
@@ -148,25 +243,31 @@ void *MemoryPool::Allocate( size_t amount )
 		return NULL;
 	}
 
-	if( !m_HeadOfFreeList ) {
-		// allocate new bubble
-		AllocNewBubble();
+	Bubble* bubble = m_CurrentBubble;
+	if( bubble == NULL || bubble->freeList == NULL ) {
+		bubble = TakeFullestPartialBubble();
+		if( bubble == NULL )
+			bubble = AllocNewBubble();
 
 		// Can't allocate
-		if( m_HeadOfFreeList == NULL )
+		if( bubble == NULL )
 			return NULL;
+		m_CurrentBubble = bubble;
 	}
 
-#if DEBUGMODE
 	++m_AllocCount;
+#if DEBUGMODE
 	if( m_AllocCount > m_PeakAllocCount )
 		m_PeakAllocCount = m_AllocCount;
 #endif
 
-	returnBlock = m_HeadOfFreeList;
+	if( bubble->liveCount++ == 0 )
+		--m_EmptyBubbleCount;
+
+	returnBlock = bubble->freeList;
 
 	// move the pointer to the next block
-	m_HeadOfFreeList = *((void**)m_HeadOfFreeList);
+	bubble->freeList = *((void**)returnBlock);
 
 	return returnBlock;
 }
@@ -180,32 +281,258 @@ void MemoryPool::Deallocate( void *mem_Block )
 	if( !mem_Block ) // ignore NULL deletes
 		return;
 
+	Bubble* bubble = GetBubble(mem_Block);
+
 #if DEBUGMODE
 	// check to see if the memory is from the allocated range
-	bool ok = false;
-	size_t n = m_Bubbles.size();
-	for( size_t i = 0; i < n; ++i ) {
-		Bubble* p = m_Bubbles[i];
-		if( (char*)mem_Block >= p->data && (char*)mem_Block < (p->data + m_BlockSize * m_BlocksPerBubble) ) {
-			ok = true;
-			break;
-		}
-	}
-	AssertIf( !ok );
-#endif
+	size_t offset = (char*)mem_Block - GetBubbleData(bubble);
+	AssertIf( offset >= (size_t)(m_BlockSize * m_BlocksPerBubble) || offset % m_BlockSize != 0 );
 
-#if DEBUGMODE
 	// invalidate the memory
 	memset( mem_Block, 0xDD, m_BlockSize );
 	AssertIf(m_AllocCount == 0);
+	AssertIf(bubble->liveCount == 0);
 #endif
 
-#if DEBUGMODE
 	--m_AllocCount;
-#endif
+
+	// a full bubble gets free blocks again
+	if( bubble->freeList == NULL && bubble != m_CurrentBubble )
+		AddPartialBubble(bubble);
 
 	// make the block point to the first free item in the list
-	*((void**)mem_Block) = m_HeadOfFreeList;
+	*((void**)mem_Block) = bubble->freeList;
 	// the list head is now the Deallocated block
-	m_HeadOfFreeList = mem_Block;
+	bubble->freeList = mem_Block;
+
+	if( --bubble->liveCount == 0 )
+	{
+		++m_EmptyBubbleCount;
+		if( m_TrimAutomatically && m_EmptyBubbleCount > kMaxEmptyBubbles )
+			FreeBubble(bubble);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+
+// keeps blocks 16 byte aligned
+static const int kConcurrentBubbleHeaderSize = 16;
+
+// bumps the tag in the high bits and puts the new first handle in the low bits
+static inline UInt64 MakeFreeListHead(UInt64 oldHead, UInt32 handle)
+{
+	return ((oldHead >> 32) + 1) << 32 | handle;
+}
+
+UNITY_VECTOR(kMemPoolAlloc,ConcurrentMemoryPool*)* ConcurrentMemoryPool::s_MemoryPools = NULL;
+static Mutex s_ConcurrentMemoryPoolsMutex;
+
+void ConcurrentMemoryPool::StaticInitialize()
+{
+	s_MemoryPools = UNITY_NEW(UNITY_VECTOR(kMemPoolAlloc,ConcurrentMemoryPool*),kMemPoolAlloc);
+}
+
+void ConcurrentMemoryPool::StaticDestroy()
+{
+	for(size_t i = 0; i < s_MemoryPools->size(); i++)
+		UNITY_DELETE((*s_MemoryPools)[i],kMemPoolAlloc);
+	UNITY_DELETE(s_MemoryPools,kMemPoolAlloc);
+}
+
+static RegisterRuntimeInitializeAndCleanup s_ConcurrentMemoryPoolCallbacks(ConcurrentMemoryPool::StaticInitialize, ConcurrentMemoryPool::StaticDestroy);
+
+ConcurrentMemoryPool& ConcurrentMemoryPool::GetStaticMemoryPool( ConcurrentMemoryPool* volatile& pool, int blockSize )
+{
+	Mutex::AutoLock lock(s_ConcurrentMemoryPoolsMutex);
+	if (pool == NULL)
+	{
+		SET_ALLOC_OWNER(NULL);
+		ConcurrentMemoryPool* newPool = UNITY_NEW(ConcurrentMemoryPool( "concurrentmempoolalloc", blockSize, MemoryPool::GetBubbleSizeForBlockSize(blockSize), kMemPoolAlloc ), kMemPoolAlloc);
+		s_MemoryPools->push_back(newPool);
+		pool = newPool;
+	}
+	return *pool;
+}
+
+ConcurrentMemoryPool::ConcurrentMemoryPool( const char* name, int blockSize, int hintSize, MemLabelId label )
+	: m_FreeList(0)
+	, m_AllocCount(0)
+	, m_BubbleCount(0)
+	, m_Slabs(MemLabelId(label.label, GET_CURRENT_ALLOC_ROOT_HEADER()))
+	, m_SlabNext(NULL)
+	, m_SlabEnd(NULL)
+	, m_AllocLabel(MemLabelId(label.label, GET_CURRENT_ALLOC_ROOT_HEADER()))
+	, m_Name(name)
+{
+	if (blockSize < kMinBlockSize)
+		blockSize = kMinBlockSize;
+	m_BlockSize = blockSize;
+
+	// bubbles have to be a power of two to be found by masking
+	m_BubbleSize = NextPowerOfTwo(hintSize);
+	m_BubbleShift = HighestBit(m_BubbleSize);
+	m_BlocksPerBubble = (m_BubbleSize - kConcurrentBubbleHeaderSize) / blockSize;
+
+	// bubble index and offset have to fit in a 32 bit handle
+	m_MaxBubbles = kMaxBubbleChunks * kBubblesPerChunk;
+	if (m_BubbleShift > 16)
+		m_MaxBubbles = std::min(m_MaxBubbles, 1 << (32 - m_BubbleShift));
+
+	Assert (m_BlocksPerBubble >= 128);
+	Assert(hintSize % 4096 == 0);
+
+	memset(m_Bubbles, 0, sizeof(m_Bubbles));
+}
+
+ConcurrentMemoryPool::~ConcurrentMemoryPool()
+{
+#if !UNITY_EDITOR && DEBUGMODE
+	if (m_AllocCount > 0)
+		ErrorStringMsg( "Memory pool has %d unallocated objects: %s", m_AllocCount, m_Name ); // some stuff not deallocated?
+#endif
+	for (size_t i = 0; i < m_Slabs.size(); ++i)
+		UNITY_FREE( m_AllocLabel, m_Slabs[i] );
+	for (int i = 0; i < kMaxBubbleChunks; ++i)
+		UNITY_FREE( m_AllocLabel, m_Bubbles[i] );
+}
+
+char* ConcurrentMemoryPool::AllocBubbleFromSlab()
+{
+	if ((size_t)(m_SlabEnd - m_SlabNext) < (size_t)m_BubbleSize)
+	{
+		// Bubbles have to be aligned to their size, and an aligned allocation per bubble can cost up to
+		// twice the bubble. The aligned bubbles in a bigger slab only leave one bubble of slack per slab.
+		size_t slabSize = (size_t)kBubblesPerSlab * m_BubbleSize;
+		char* slab = (char*)UNITY_MALLOC( m_AllocLabel, slabSize );
+		if (slab == NULL)
+			return NULL;
+		m_Slabs.push_back(slab);
+		m_SlabNext = (char*)(((size_t)slab + m_BubbleSize - 1) & ~(size_t)(m_BubbleSize - 1));
+		m_SlabEnd = slab + slabSize;
+	}
+
+	char* bubble = m_SlabNext;
+	m_SlabNext += m_BubbleSize;
+	return bubble;
+}
+
+void* ConcurrentMemoryPool::AllocNewBubble(bool& outOfMemory)
+{
+	Mutex::AutoLock lock(m_BubbleMutex);
+
+	// another thread might have grown the pool while we were waiting
+	if ((UInt32)AtomicRead64(&m_FreeList) != 0)
+		return NULL;
+
+	int index = m_BubbleCount;
+	if (index >= m_MaxBubbles)
+	{
+		ErrorString( "out of memory!" );
+		outOfMemory = true;
+		return NULL;
+	}
+
+	char** chunk = m_Bubbles[index / kBubblesPerChunk];
+	if (chunk == NULL)
+	{
+		chunk = (char**)UNITY_MALLOC( m_AllocLabel, kBubblesPerChunk * sizeof(char*) );
+		m_Bubbles[index / kBubblesPerChunk] = chunk;
+	}
+
+	char* bubble = chunk != NULL ? AllocBubbleFromSlab() : NULL;
+	if (bubble == NULL)
+	{
+		ErrorString( "out of memory!" );
+		outOfMemory = true;
+		return NULL;
+	}
+	((Bubble*)bubble)->index = index;
+	chunk[index % kBubblesPerChunk] = bubble;
+	m_BubbleCount = index + 1;
+
+	// keep the first block for the caller and chain up the rest
+	char* first = bubble + kConcurrentBubbleHeaderSize;
+	UInt32 firstHandle = ((UInt32)index << m_BubbleShift) | kConcurrentBubbleHeaderSize;
+	char* block = first + m_BlockSize;
+	for (int j = 1; j < m_BlocksPerBubble-1; ++j, block += m_BlockSize)
+		*(UInt32*)block = firstHandle + (j+1) * m_BlockSize;
+	char* last = block;
+
+	// publish the chain, the compare exchange makes the bubble table entry visible to other threads
+	for (;;)
+	{
+		UInt64 head = AtomicRead64(&m_FreeList);
+		*(volatile UInt32*)last = (UInt32)head;
+		if (AtomicCompareExchange64(&m_FreeList, MakeFreeListHead(head, firstHandle + m_BlockSize), head))
+			break;
+	}
+
+	return first;
+}
+
+void* ConcurrentMemoryPool::Allocate()
+{
+	return Allocate( m_BlockSize );
+}
+
+void* ConcurrentMemoryPool::Allocate( size_t amount )
+{
+	if( amount > (unsigned int)m_BlockSize ) {
+		ErrorString( Format("requested larger amount than block size! requested: %d, blocksize: %d", (unsigned)amount, (unsigned)m_BlockSize ));
+		return NULL;
+	}
+
+	for (;;)
+	{
+		UInt64 head = AtomicRead64(&m_FreeList);
+		UInt32 handle = (UInt32)head;
+		if (handle == 0)
+		{
+			bool outOfMemory = false;
+			void* block = AllocNewBubble(outOfMemory);
+			if (block != NULL)
+			{
+				AtomicIncrement(&m_AllocCount);
+				return block;
+			}
+			if (outOfMemory)
+				return NULL;
+			continue;
+		}
+
+		// the block may be handed out by another thread after we read the head.
+		// Its memory stays valid though, and the tag makes the exchange fail in that case.
+		void* block = GetBlock(handle);
+		UInt32 next = *(volatile UInt32*)block;
+		if (AtomicCompareExchange64(&m_FreeList, MakeFreeListHead(head, next), head))
+		{
+			AtomicIncrement(&m_AllocCount);
+			return block;
+		}
+	}
+}
+
+void ConcurrentMemoryPool::Deallocate( void* mem_Block )
+{
+	if( !mem_Block ) // ignore NULL deletes
+		return;
+
+	UInt32 handle = GetHandle(mem_Block);
+	DebugAssert(GetBlock(handle) == mem_Block);
+
+#if DEBUGMODE
+	// invalidate the memory
+	memset( mem_Block, 0xDD, m_BlockSize );
+#endif
+
+	for (;;)
+	{
+		UInt64 head = AtomicRead64(&m_FreeList);
+		*(volatile UInt32*)mem_Block = (UInt32)head;
+		if (AtomicCompareExchange64(&m_FreeList, MakeFreeListHead(head, handle), head))
+			break;
+	}
+
+	AtomicDecrement(&m_AllocCount);
 }
@@ -4,6 +4,8 @@
 #include "MemoryMacros.h"
 #include "dynamic_array.h"
 #include "ExportModules.h"
+#include "Mutex.h"
+#include "BitUtility.h"
 
 #if ENABLE_THREAD_CHECK_IN_ALLOCS
 #include "Runtime/Threads/Thread.h"
@@ -15,11 +17,20 @@
 //
 // To override new/delete per class use DECLARE_POOLED_ALLOC and DEFINE_POOLED_ALLOC.
 //
-// memory_pool<T> is an STL allocator that only supports allocating a single element
-// at a time. So it can be used with list, map, set but not with vector or string.
+// memory_pool<T> is an STL allocator that pools single elements and small arrays.
+// Arrays are served from pools of power of two element counts, up to kMemoryPoolMaxArrayElements
+// elements and kMemoryPoolMaxArrayBytes bytes. Bigger arrays go to the heap.
 //
 // Allocator creates "bubbles" of objects, each containin a free-list inside. When a bubble
-// is full, it allocates a new one. Empty bubbles are NOT destroyed.
+// is full, allocation continues in the fullest bubble that has free blocks, or a new one.
+// Bubbles are kept sorted by address, so a block finds its bubble with a binary search
+// (the current bubble is checked first). One empty bubble is kept around, further empty
+// bubbles are released right away unless automatic trimming is disabled. Trim releases
+// all empty bubbles.
+//
+// MemoryPool is not thread safe. ConcurrentMemoryPool is the thread safe variant, use
+// DECLARE_CONCURRENT_POOLED_ALLOC or memory_pool<T, true> (concurrent_memory_pool<T>) for pools
+// shared between threads.
 
 
 // --------------------------------------------------------------------------
@@ -37,6 +48,8 @@ public:
 	void	Deallocate( void *ptr );
 	/// Deallocate everything
 	void	DeallocateAll();
+	/// Release all empty bubbles
+	void	Trim();
 
 
 	#if !DEPLOY_OPTIMIZED
@@ -52,30 +65,46 @@ public:
 
 	void PreallocateMemory(int size);
 	void SetAllocateMemoryAutomatically (bool allocateMemoryAuto) { m_AllocateMemoryAutomatically = allocateMemoryAuto; }
+	void SetTrimAutomatically (bool trimAuto) { m_TrimAutomatically = trimAuto; }
 
 	static void StaticInitialize();
 	static void StaticDestroy();
 	static void RegisterStaticMemoryPool(MemoryPool* pool);
+	// bubble size hint that holds enough blocks of blockSize
+	static int GetBubbleSizeForBlockSize(int blockSize);
 
 private:
-	void	AllocNewBubble();
-
+	// header at the start of each bubble, the blocks follow after kBubbleHeaderSize bytes
 	struct Bubble
 	{
-		char	data[1]; // actually byteCount
+		void*	freeList; // first free block in this bubble
+		int		liveCount; // blocks handed out from this bubble
+		int		partialIndex; // position in m_PartialBubbles, -1 if not in there
 	};
 	typedef dynamic_array<Bubble*>	Bubbles;
 
+	Bubble*	AllocNewBubble();
+	void	FreeBubble( Bubble* bubble );
+	Bubble*	GetBubble( const void* ptr ) const;
+	char*	GetBubbleData( Bubble* bubble ) const;
+
+	void	AddPartialBubble( Bubble* bubble );
+	void	RemovePartialBubble( Bubble* bubble );
+	Bubble*	TakeFullestPartialBubble();
+
 	void	Reset();
 private:
 	int 	m_BlockSize;
 	int 	m_BubbleSize;
 	int 	m_BlocksPerBubble;
 
-	Bubbles	m_Bubbles;
+	Bubbles	m_Bubbles; // sorted by address
+	Bubbles	m_PartialBubbles; // bubbles with free blocks, except the current one
+	Bubble*	m_CurrentBubble; // bubble allocations are served from
+	int 	m_EmptyBubbleCount;
 
-	void*	m_HeadOfFreeList;
 	bool    m_AllocateMemoryAutomatically;
+	bool    m_TrimAutomatically;
 
 	MemLabelId m_AllocLabel;
 
@@ -93,6 +122,92 @@ private:
 };
 
 
+// --------------------------------------------------------------------------
+// Thread safe fixed size allocator with a lock-free free list.
+//
+// Bubbles are aligned to their (power of two) size, so a block finds its bubble by masking
+// its address. They are carved out of slabs of several bubbles, so the alignment doesn't
+// cost a bubble of padding each. Blocks are addressed by 32 bit handles (bubble index and offset), which leaves
+// room for a 32 bit tag next to the free list head in a single 64 bit compare exchange.
+// The tag is bumped on every update to avoid ABA. Only growing takes a lock.
+// Bubbles are only released when the pool is destroyed.
+
+class EXPORT_COREMODULE ConcurrentMemoryPool {
+public:
+	ConcurrentMemoryPool( const char* name, int blockSize, int allocatedSizeHint, MemLabelId label = kMemPoolAlloc );
+	~ConcurrentMemoryPool();
+
+	/// Allocate single block
+	void*	Allocate();
+	/// Allocate less than single block
+	void*	Allocate( size_t amount );
+	/// Deallocate
+	void	Deallocate( void *ptr );
+
+	size_t	GetBubbleCount() const { return m_BubbleCount; }
+	int		GetAllocCount() const { return m_AllocCount; }
+	int		GetAllocatedBytes() const { return m_BubbleCount * m_BubbleSize; }
+
+	static void StaticInitialize();
+	static void StaticDestroy();
+	// Creates the pool stored in 'pool' on first use. Pools created this way are destroyed in StaticDestroy.
+	static ConcurrentMemoryPool& GetStaticMemoryPool( ConcurrentMemoryPool* volatile& pool, int blockSize );
+
+private:
+	struct Bubble
+	{
+		UInt32	index;
+	};
+
+	// NULL when another thread grew the pool first, or with outOfMemory set when the pool can't grow
+	void*	AllocNewBubble(bool& outOfMemory);
+	char*	AllocBubbleFromSlab();
+
+	void*	GetBlock( UInt32 handle ) const;
+	UInt32	GetHandle( const void* ptr ) const;
+
+	// bubble table is two levels, so it never moves while other threads read it
+	enum { kBubblesPerChunk = 1024, kMaxBubbleChunks = 64, kBubblesPerSlab = 8 };
+
+	volatile UInt64	m_FreeList; // handle of the first free block in the low bits, tag in the high bits
+	volatile int	m_AllocCount;
+
+	int 	m_BlockSize;
+	int 	m_BubbleSize;
+	int 	m_BubbleShift;
+	int 	m_BlocksPerBubble;
+
+	char**	m_Bubbles[kMaxBubbleChunks];
+	volatile int m_BubbleCount;
+	int		m_MaxBubbles;
+	Mutex	m_BubbleMutex;
+
+	// bubbles are taken from the current slab, only touched with m_BubbleMutex held
+	dynamic_array<void*>	m_Slabs;
+	char*	m_SlabNext;
+	char*	m_SlabEnd;
+
+	MemLabelId m_AllocLabel;
+	const char*	m_Name;
+
+	static UNITY_VECTOR(kMemPoolAlloc,ConcurrentMemoryPool*)* s_MemoryPools;
+};
+
+
+inline void* ConcurrentMemoryPool::GetBlock( UInt32 handle ) const
+{
+	UInt32 index = handle >> m_BubbleShift;
+	return m_Bubbles[index / kBubblesPerChunk][index % kBubblesPerChunk] + (handle & (m_BubbleSize - 1));
+}
+
+inline UInt32 ConcurrentMemoryPool::GetHandle( const void* ptr ) const
+{
+	size_t offset = (size_t)ptr & (m_BubbleSize - 1);
+	const Bubble* bubble = (const Bubble*)((const char*)ptr - offset);
+	return (bubble->index << m_BubbleShift) | (UInt32)offset;
+}
+
+
 // --------------------------------------------------------------------------
 //  Macros for class fixed-size pooled allocations:
 //		DECLARE_POOLED_ALLOC in the .h file, in a private section of a class,
@@ -117,12 +232,32 @@ private:
 	MemoryPool* _clazz::s_PoolAllocator = NULL; \
 	int _clazz::s_PoolSize = _bubbleSize;
 
+// Same as above for classes that are created and destroyed from several threads
+#define STATIC_INITIALIZE_CONCURRENT_POOL( _clazz ) _clazz::s_PoolAllocator = UNITY_NEW(ConcurrentMemoryPool, kMemPoolAlloc)(#_clazz, sizeof(_clazz), _clazz::s_PoolSize)
+#define STATIC_DESTROY_CONCURRENT_POOL( _clazz ) UNITY_DELETE(_clazz::s_PoolAllocator, kMemPoolAlloc)
+
+#define DECLARE_CONCURRENT_POOLED_ALLOC( _clazz ) \
+public:	\
+	inline void* operator new( size_t size ) { return s_PoolAllocator->Allocate(size); } \
+	inline void	operator delete( void* p ) { s_PoolAllocator->Deallocate(p); } \
+	static ConcurrentMemoryPool *s_PoolAllocator; \
+	static int s_PoolSize; \
+private:
+
+#define DEFINE_CONCURRENT_POOLED_ALLOC( _clazz, _bubbleSize ) \
+	ConcurrentMemoryPool* _clazz::s_PoolAllocator = NULL; \
+	int _clazz::s_PoolSize = _bubbleSize;
+
 #else
 
 #define STATIC_INITIALIZE_POOL( _clazz )
 #define STATIC_DESTROY_POOL( _clazz )
 #define DECLARE_POOLED_ALLOC( _clazz )
 #define DEFINE_POOLED_ALLOC( _clazz, _bubbleSize )
+#define STATIC_INITIALIZE_CONCURRENT_POOL( _clazz )
+#define STATIC_DESTROY_CONCURRENT_POOL( _clazz )
+#define DECLARE_CONCURRENT_POOLED_ALLOC( _clazz )
+#define DEFINE_CONCURRENT_POOLED_ALLOC( _clazz, _bubbleSize )
 
 #endif
 
@@ -137,7 +272,7 @@ struct memory_pool_impl
 		AutoPoolWrapper( int size)
 		{
 			SET_ALLOC_OWNER(NULL);
-			pool = UNITY_NEW(MemoryPool( true, "mempoolalloc", size, 32 * 1024, kMemPoolAlloc ), kMemPoolAlloc);
+			pool = UNITY_NEW(MemoryPool( true, "mempoolalloc", size, MemoryPool::GetBubbleSizeForBlockSize(size), kMemPoolAlloc ), kMemPoolAlloc);
 			MemoryPool::RegisterStaticMemoryPool(pool);
 		}
 		~AutoPoolWrapper()
@@ -151,15 +286,100 @@ struct memory_pool_impl
 	}
 };
 
+enum
+{
+	kMemoryPoolMaxArrayElements = 16,
+	kMemoryPoolMaxArrayBytes = 1024
+};
+
+// Pools for arrays of SIZE sized elements, by element count rounded up to a power of two.
+// The pools are shared with single element pools of the same size.
+template<int SIZE>
+struct memory_pool_array_impl
+{
+	static bool is_pooled (size_t n) {
+		return n <= kMemoryPoolMaxArrayElements && NextPowerOfTwo(n) * SIZE <= kMemoryPoolMaxArrayBytes;
+	}
+	static MemoryPool& get_pool (size_t n) {
+		switch (NextPowerOfTwo(n))
+		{
+			case 0:
+			case 1: return memory_pool_impl<SIZE>::get_pool ();
+			case 2: return memory_pool_impl<SIZE * 2>::get_pool ();
+			case 4: return memory_pool_impl<SIZE * 4>::get_pool ();
+			case 8: return memory_pool_impl<SIZE * 8>::get_pool ();
+			default: return memory_pool_impl<SIZE * 16>::get_pool ();
+		}
+	}
+};
+
 /*
 
   THIS IS NOT THREAD SAFE. sharing of pools is by size, thus pools might randomly be shared from different threads.
+  Use memory_pool<T, true> (or concurrent_memory_pool<T>) for containers that are used from several threads.
 
 */
 
+template<int SIZE>
+struct concurrent_memory_pool_impl
+{
+	static ConcurrentMemoryPool* volatile s_Pool;
+	static ConcurrentMemoryPool& get_pool () {
+		if (s_Pool != NULL)
+			return *s_Pool;
+		return ConcurrentMemoryPool::GetStaticMemoryPool(s_Pool, SIZE);
+	}
+};
 
+template<int SIZE>
+ConcurrentMemoryPool* volatile concurrent_memory_pool_impl<SIZE>::s_Pool = NULL;
 
-template<typename T>
+// Picks the pools for memory_pool, single elements and small arrays for the main thread pools,
+// only single elements for the concurrent ones.
+template<int SIZE, bool Concurrent>
+struct memory_pool_select
+{
+	static void* allocate (size_t n)
+	{
+		if(n==1)
+			return memory_pool_impl<SIZE>::get_pool ().Allocate(SIZE);
+		else if(memory_pool_array_impl<SIZE>::is_pooled(n))
+			return memory_pool_array_impl<SIZE>::get_pool (n).Allocate(n * SIZE);
+		else
+			return UNITY_MALLOC(kMemPoolAlloc,n*SIZE);
+	}
+	static void deallocate (void* p, size_t n)
+	{
+		if(n==1)
+			memory_pool_impl<SIZE>::get_pool ().Deallocate( p );
+		else if(memory_pool_array_impl<SIZE>::is_pooled(n))
+			memory_pool_array_impl<SIZE>::get_pool (n).Deallocate( p );
+		else
+			UNITY_FREE(kMemPoolAlloc,p);
+	}
+};
+
+template<int SIZE>
+struct memory_pool_select<SIZE, true>
+{
+	static void* allocate (size_t n)
+	{
+		if(n==1)
+			return concurrent_memory_pool_impl<SIZE>::get_pool ().Allocate(SIZE);
+		else
+			return UNITY_MALLOC(kMemPoolAlloc,n*SIZE);
+	}
+	static void deallocate (void* p, size_t n)
+	{
+		if(n==1)
+			concurrent_memory_pool_impl<SIZE>::get_pool ().Deallocate( p );
+		else
+			UNITY_FREE(kMemPoolAlloc,p);
+	}
+};
+
+
+template<typename T, bool Concurrent = false>
 class memory_pool
 {
 public:
@@ -171,12 +391,12 @@ public:
 	typedef const T&  const_reference;
 	typedef T         value_type;
 
-	template <class U> struct rebind { typedef memory_pool<U> other; };
+	template <class U> struct rebind { typedef memory_pool<U, Concurrent> other; };
 
 	memory_pool() { }
-	memory_pool( const memory_pool<T>& ) { }
-	template<class B> memory_pool(const memory_pool<B>&) { } // construct from a related allocator
-	template<class B> memory_pool<T>& operator=(const memory_pool<B>&) { return *this; } // assign from a related allocator
+	memory_pool( const memory_pool<T, Concurrent>& ) { }
+	template<class B> memory_pool(const memory_pool<B, Concurrent>&) { } // construct from a related allocator
+	template<class B> memory_pool<T, Concurrent>& operator=(const memory_pool<B, Concurrent>&) { return *this; } // assign from a related allocator
 
 	~memory_pool() throw() { }
 
@@ -188,21 +408,26 @@ public:
 
 	pointer allocate(size_type n, std::allocator<void>::const_pointer /*hint*/ = 0)
 	{
-		if(n==1)
-			return reinterpret_cast<pointer>( memory_pool_impl<sizeof(T)>::get_pool ().Allocate(n * sizeof(T)) );
-		else
-			return reinterpret_cast<pointer>(UNITY_MALLOC(kMemPoolAlloc,n*sizeof(T)));
+		return reinterpret_cast<pointer>( memory_pool_select<sizeof(T), Concurrent>::allocate(n) );
 	}
 
 	void deallocate(pointer p, size_type n)
 	{
-		if(n==1)
-			return memory_pool_impl<sizeof(T)>::get_pool ().Deallocate( p );
-		else
-			return UNITY_FREE(kMemPoolAlloc,p);
+		memory_pool_select<sizeof(T), Concurrent>::deallocate(p, n);
 	}
 };
 
+// memory_pool<T, true> under its own name
+template<typename T>
+class concurrent_memory_pool : public memory_pool<T, true>
+{
+public:
+	template <class U> struct rebind { typedef concurrent_memory_pool<U> other; };
+
+	concurrent_memory_pool() { }
+	template<class B> concurrent_memory_pool(const concurrent_memory_pool<B>&) { } // construct from a related allocator
+};
+
 template<typename T>
 class memory_pool_explicit
 {
@@ -247,21 +472,20 @@ public:
 	}
 };
 
-template<typename A, typename B>
-inline bool operator==( const memory_pool<A>&, const memory_pool<B>& )
+template<typename A, typename B, bool Concurrent>
+inline bool operator==( const memory_pool<A, Concurrent>&, const memory_pool<B, Concurrent>& )
 {
 	// test for allocator equality (always true)
 	return true;
 }
 
-template<typename A, typename B>
-inline bool operator!=( const memory_pool<A>&, const memory_pool<B>& )
+template<typename A, typename B, bool Concurrent>
+inline bool operator!=( const memory_pool<A, Concurrent>&, const memory_pool<B, Concurrent>& )
 {
 	// test for allocator inequality (always false)
 	return false;
 }
 
-
 template<typename A, typename B>
 inline bool operator==( const memory_pool_explicit<A>& lhs, const memory_pool_explicit<B>& rhs)
 {
@@ -7,8 +7,9 @@
 #define RECORD_ALLOCATION_SITES 0
 #define ENABLE_STACKS_ON_ALL_ALLOCS 0
 #define MAINTAIN_RELATED_ALLOCATION_LIST 1
+// SEGREGATE_SHORT_LIVED_ALLOCATIONS is in AllocatorLabels.h, the MemoryManager needs it too
 
-#if ENABLE_STACKS_ON_ALL_ALLOCS
+#if ENABLE_STACKS_ON_ALL_ALLOCS || SEGREGATE_SHORT_LIVED_ALLOCATIONS
 #undef RECORD_ALLOCATION_SITES
 #define RECORD_ALLOCATION_SITES 1
 #endif
@@ -51,7 +52,7 @@ public:
 	void ThreadCleanup();
 
 	static void InitAllocation(void* ptr, BaseAllocator* alloc);
-	void RegisterAllocation(void* ptr, MemLabelRef label, const char* file, int line, size_t size = 0);
+	void RegisterAllocation(void* ptr, BaseAllocator* alloc, MemLabelRef label, const char* file, int line, size_t size = 0);
 	void UnregisterAllocation(void* ptr, BaseAllocator* alloc, size_t size, ProfilerAllocationHeader** rootHeader, MemLabelRef label);
 
 	void TransferOwnership(void* ptr, BaseAllocator* alloc, ProfilerAllocationHeader* newRootHeader);
@@ -92,6 +93,19 @@ public:
 
 	static bool IsRecording() {return m_RecordingAllocation;}
 
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	// allocations freed within kShortLivedFrameCount frames count as short lived
+	void FrameMaintenance() { m_FrameIndex++; }
+	// true when enough allocations of this site were seen, and nearly all of them were short lived.
+	// Called on every allocation, so it only reads the prediction table: no lock, no site lookup
+	bool IsShortLivedAllocationSite(MemLabelRef label, const char* file, int line) const
+	{
+		const UInt32 hash = GetSitePredictionHash(label.label, file, line);
+		const volatile UInt32* bucket = &m_ShortLivedSites[hash & (kSitePredictionCount - 2)];
+		return bucket[0] == (hash | 1) || bucket[1] == (hash | 1);
+	}
+#endif
+
 
 	struct MemoryStackEntry
 	{
@@ -174,6 +188,10 @@ public:
 		int ownedCount;
 		size_t cummulativeAllocated;
 		size_t cummulativeAlloccount;
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+		int shortLivedCount;
+		int longLivedCount;
+#endif
 
 		bool operator()(const AllocationSite& s1, const AllocationSite& s2) const
 		{
@@ -200,6 +218,9 @@ private:
 	{
 		size_t size;
 		const AllocationSite* site;
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+		UInt32 allocationFrame;
+#endif
 	};
 
 	// map used for headers for allocations that don't support profileheaders
@@ -209,6 +230,28 @@ private:
 	AllocationSizes* m_AllocationSizes;
 #endif
 
+#if SEGREGATE_SHORT_LIVED_ALLOCATIONS
+	enum
+	{
+		kShortLivedFrameCount = 2,
+		kMinLifetimeSamples = 64,
+		kMaxLifetimeSamples = 1024, // the counts of a site are halved when they reach it
+		kSitePredictionCount = 8192
+	};
+	void RegisterLifetime(const AllocationSite* site, UInt32 allocationFrame);
+	static UInt32 GetSitePredictionHash(int label, const char* file, int line)
+	{
+		UInt32 hash = (UInt32)((size_t)file >> 2) * 2654435761U;
+		hash ^= ((UInt32)line * 0x85EBCA6BU) ^ ((UInt32)label * 0xC2B2AE35U);
+		return hash ^ (hash >> 15);
+	}
+
+	volatile UInt32 m_FrameIndex;
+	// hash | 1 of the sites predicted to be short lived, two per bucket. Written by RegisterLifetime under m_Mutex,
+	// read without it; a site that doesn't find room in its bucket only loses its prediction
+	volatile UInt32 m_ShortLivedSites[kSitePredictionCount];
+#endif
+
 	struct AllocationSiteSizeSorter {
 		bool operator()( const std::pair<const AllocationSite*,size_t>& a, const std::pair<const AllocationSite*,size_t>& b ) const
 		{
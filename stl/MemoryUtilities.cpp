@@ -13,3 +13,71 @@ void memset32 (void *dst, UInt32 value, UInt64 bytecount)
 		((char*)dst)[i] = ((char*)&value)[i&4];
 	}
 }
+
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+
+#if !UNITY_WIN
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+size_t GetVirtualMemoryPageSize()
+{
+	static size_t s_PageSize = 0;
+	if (s_PageSize == 0)
+	{
+#if UNITY_WIN
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		s_PageSize = info.dwPageSize;
+#else
+		s_PageSize = sysconf(_SC_PAGESIZE);
+#endif
+	}
+	return s_PageSize;
+}
+
+void* ReserveVirtualMemory(size_t size)
+{
+#if UNITY_WIN
+	return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+bool CommitVirtualMemory(void* ptr, size_t size)
+{
+#if UNITY_WIN
+	return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+	return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void DecommitVirtualMemory(void* ptr, size_t size)
+{
+#if UNITY_WIN
+	VirtualFree(ptr, size, MEM_DECOMMIT);
+#else
+	// drop the physical pages and protect the range again, so touching it without a commit faults
+#if UNITY_OSX
+	madvise(ptr, size, MADV_FREE);
+#else
+	madvise(ptr, size, MADV_DONTNEED);
+#endif
+	mprotect(ptr, size, PROT_NONE);
+#endif
+}
+
+void ReleaseVirtualMemory(void* ptr, size_t size)
+{
+#if UNITY_WIN
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, size);
+#endif
+}
+
+#endif
@@ -1,3 +1,16 @@
 #pragma once
 
 void memset32(void *dst, UInt32 value, UInt64 bytecount);
+
+// Reserving address space without backing it with physical memory.
+// Reserved pages have to be committed before they are touched, and can be
+// decommitted again to hand the physical pages back to the OS.
+#define SUPPORT_VIRTUAL_MEMORY_RESERVE (UNITY_WIN && !UNITY_WP8 || UNITY_OSX || UNITY_LINUX)
+
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+size_t GetVirtualMemoryPageSize();
+void* ReserveVirtualMemory(size_t size);
+bool CommitVirtualMemory(void* ptr, size_t size);
+void DecommitVirtualMemory(void* ptr, size_t size);
+void ReleaseVirtualMemory(void* ptr, size_t size);
+#endif
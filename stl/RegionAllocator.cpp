@@ -0,0 +1,312 @@
+#include "UnityPrefix.h"
+#include "RegionAllocator.h"
+#if ENABLE_MEMORY_MANAGER
+
+#include "MemoryManager.h"
+#include "AtomicOps.h"
+#include "StaticAssert.h"
+
+template<class LLAllocator>
+RegionAllocator<LLAllocator>::RegionAllocator(size_t chunkSize, bool useLocking, const char* name)
+	: BaseAllocator(name)
+	, m_Chunks(NULL)
+	, m_ReleasedChunks(NULL)
+	, m_LowestAddress(NULL)
+	, m_HighestAddress(NULL)
+	, m_ChunkSize(chunkSize)
+	, m_UseLocking(useLocking)
+{
+	CompileTimeAssert(sizeof(Chunk) <= kChunkHeaderSize, "Chunk header does not fit");
+	m_Registered = GetMemoryManager().AddRegionAllocator(this);
+}
+
+template<class LLAllocator>
+RegionAllocator<LLAllocator>::~RegionAllocator()
+{
+	if (m_Registered)
+		GetMemoryManager().RemoveRegionAllocator(this);
+
+	Mutex::AutoLock m(m_RegionMutex);
+#if ENABLE_REGION_ALLOCATOR_ESCAPE_CHECK
+	CheckIntegrity();
+#endif
+	FreeChunks(m_Chunks);
+	FreeChunks(m_ReleasedChunks);
+}
+
+template<class LLAllocator>
+void RegionAllocator<LLAllocator>::FreeChunks(Chunk* chunks)
+{
+	while (chunks != NULL)
+	{
+		Chunk* chunk = chunks;
+		chunks = chunk->next;
+		m_TotalReservedMemory -= kChunkHeaderSize + chunk->size;
+		LLAllocator::Free(chunk);
+	}
+}
+
+template<class LLAllocator>
+void* RegionAllocator<LLAllocator>::AllocateInChunk(Chunk* chunk, size_t size, int align)
+{
+	// the requested size is kept in front of the allocation, a header of align bytes keeps the pointer aligned
+	char* ptr = (char*)AlignPtr(chunk->current, align) + align;
+	if (ptr + size > chunk->end)
+		return NULL;
+
+	((size_t*)ptr)[-1] = size;
+	chunk->current = ptr + size;
+	return ptr;
+}
+
+template<class LLAllocator>
+typename RegionAllocator<LLAllocator>::Chunk* RegionAllocator<LLAllocator>::AddChunk(size_t minSize, bool asCurrent)
+{
+	size_t size = std::max(minSize, m_ChunkSize);
+	Chunk* chunk = (Chunk*)LLAllocator::Malloc(kChunkHeaderSize + size);
+	if (chunk == NULL)
+		return NULL;
+
+	chunk->current = chunk->GetData();
+	chunk->end = chunk->GetData() + size;
+	chunk->size = size;
+	m_TotalReservedMemory += kChunkHeaderSize + size;
+
+	// a chunk for a single large allocation goes behind the current one, which stays in use
+	if (asCurrent || m_Chunks == NULL)
+	{
+		chunk->next = m_Chunks;
+		m_Chunks = chunk;
+	}
+	else
+	{
+		chunk->next = m_Chunks->next;
+		m_Chunks->next = chunk;
+	}
+
+	ExtendAddressRange(chunk);
+	return chunk;
+}
+
+template<class LLAllocator>
+void RegionAllocator<LLAllocator>::ExtendAddressRange(Chunk* chunk)
+{
+	if (m_LowestAddress == NULL || chunk->GetData() < m_LowestAddress)
+		m_LowestAddress = chunk->GetData();
+	if (chunk->end > m_HighestAddress)
+		m_HighestAddress = chunk->end;
+}
+
+template<class LLAllocator>
+void* RegionAllocator<LLAllocator>::Allocate(size_t size, int align)
+{
+	DebugAssert(align > 0 && IsPowerOfTwo(align));
+	align = std::max<int>(align, sizeof(size_t));
+
+	// frees of its pointers wouldn't find an unregistered region
+	if (!m_Registered)
+		return NULL;
+
+	Lock();
+
+	void* ptr = NULL;
+	if (m_Chunks != NULL)
+		ptr = AllocateInChunk(m_Chunks, size, align);
+
+	Chunk* newChunk = NULL;
+	const char* newChunkEnd = NULL;
+	if (ptr == NULL)
+	{
+		size_t neededSize = size + 2 * align;
+		if (!m_UseLocking)
+			m_RegionMutex.Lock();
+		newChunk = AddChunk(neededSize, neededSize < m_ChunkSize / 4);
+		if (!m_UseLocking)
+			m_RegionMutex.Unlock();
+		if (newChunk != NULL)
+		{
+			newChunkEnd = newChunk->end;
+			ptr = AllocateInChunk(newChunk, size, align);
+		}
+	}
+
+	if (ptr != NULL)
+		RegisterAllocationData(size, align);
+
+	Unlock();
+
+	// outside of the region lock, the MemoryManager takes its lock before ours
+	if (newChunk != NULL)
+		GetMemoryManager().AddRegionAddressRange(newChunk->GetData(), newChunkEnd);
+
+	return ptr;
+}
+
+template<class LLAllocator>
+void* RegionAllocator<LLAllocator>::Reallocate(void* p, size_t size, int align)
+{
+	if (p == NULL)
+		return Allocate(size, align);
+
+#if ENABLE_REGION_ALLOCATOR_ESCAPE_CHECK
+	m_RegionMutex.Lock();
+	bool escaped = IsReleasedPointer(p);
+	m_RegionMutex.Unlock();
+	if (escaped)
+	{
+		ErrorStringMsg("RegionAllocator '%s': reallocating a pointer that escaped the region after Release", GetName());
+		return NULL;
+	}
+#endif
+
+	size_t oldSize = GetPtrSize(p);
+	Lock();
+
+	// the last allocation can grow or shrink in place
+	Chunk* chunk = m_Chunks;
+	bool inPlace = chunk != NULL && (char*)p + oldSize == chunk->current && (char*)p + size <= chunk->end
+		&& ((size_t)p & (align - 1)) == 0;
+	if (inPlace)
+	{
+		chunk->current = (char*)p + size;
+		((size_t*)p)[-1] = size;
+		m_TotalRequestedBytes += size - oldSize;
+	}
+
+	Unlock();
+
+	if (inPlace)
+		return p;
+
+	void* newPtr = Allocate(size, align);
+	if (newPtr != NULL)
+		memcpy(newPtr, p, std::min(size, oldSize));
+	return newPtr;
+}
+
+template<class LLAllocator>
+void RegionAllocator<LLAllocator>::Deallocate(void* p)
+{
+	// memory is only given back by Release
+#if ENABLE_REGION_ALLOCATOR_ESCAPE_CHECK
+	// any thread may free into the region, Release changes the released chunks under the lock
+	Mutex::AutoLock m(m_RegionMutex);
+	if (IsReleasedPointer(p))
+		ErrorStringMsg("RegionAllocator '%s': deallocating a pointer that escaped the region after Release", GetName());
+#endif
+}
+
+template<class LLAllocator>
+bool RegionAllocator<LLAllocator>::Contains(const void* p)
+{
+	// always locked, another thread may be adding or releasing chunks
+	Mutex::AutoLock m(m_RegionMutex);
+	if (p < m_LowestAddress || p >= m_HighestAddress)
+		return false;
+
+	bool contains = false;
+	for (Chunk* chunk = m_Chunks; chunk != NULL && !contains; chunk = chunk->next)
+		contains = chunk->Contains(p);
+
+	// released chunks are still claimed, so frees of escaped pointers end up in Deallocate
+	if (!contains)
+		contains = IsReleasedPointer(p);
+	return contains;
+}
+
+template<class LLAllocator>
+bool RegionAllocator<LLAllocator>::IsReleasedPointer(const void* p)
+{
+	for (Chunk* chunk = m_ReleasedChunks; chunk != NULL; chunk = chunk->next)
+	{
+		if (chunk->Contains(p))
+			return true;
+	}
+	return false;
+}
+
+template<class LLAllocator>
+bool RegionAllocator<LLAllocator>::CheckIntegrity()
+{
+	// released chunks must still hold the poison pattern, anything else was written through an escaped pointer
+	for (Chunk* chunk = m_ReleasedChunks; chunk != NULL; chunk = chunk->next)
+	{
+		for (const char* p = chunk->GetData(); p < chunk->current; p++)
+		{
+			if (*(const UInt8*)p != kPoisonValue)
+			{
+				ErrorStringMsg("RegionAllocator '%s': memory was written through a pointer that escaped the region after Release", GetName());
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+template<class LLAllocator>
+size_t RegionAllocator<LLAllocator>::GetPtrSize(const void* ptr) const
+{
+	return ((const size_t*)ptr)[-1];
+}
+
+template<class LLAllocator>
+void RegionAllocator<LLAllocator>::Release()
+{
+	Mutex::AutoLock m(m_RegionMutex);
+
+#if ENABLE_REGION_ALLOCATOR_ESCAPE_CHECK
+	// chunks of the previous release go back now, the current ones are poisoned and kept until the next one
+	CheckIntegrity();
+	FreeChunks(m_ReleasedChunks);
+
+	for (Chunk* chunk = m_Chunks; chunk != NULL; chunk = chunk->next)
+		memset(chunk->GetData(), kPoisonValue, chunk->current - chunk->GetData());
+	m_ReleasedChunks = m_Chunks;
+#else
+	FreeChunks(m_Chunks);
+#endif
+	m_Chunks = NULL;
+
+	// only the released chunks are claimed from now on, once per release
+	m_LowestAddress = m_HighestAddress = NULL;
+	for (Chunk* chunk = m_ReleasedChunks; chunk != NULL; chunk = chunk->next)
+		ExtendAddressRange(chunk);
+
+	m_TotalRequestedBytes = 0;
+	m_BookKeepingMemoryUsage = 0;
+	m_NumAllocations = 0;
+}
+
+template class RegionAllocator<LowLevelAllocator>;
+
+
+UNITY_TLS_VALUE(RegionAllocatorScope*) RegionAllocatorScope::s_ActiveScope;
+volatile int RegionAllocatorScope::s_ActiveScopeCount = 0;
+
+RegionAllocatorScope::RegionAllocatorScope(BaseAllocator& region, MemLabelRef label)
+	: m_Region(&region)
+	, m_Label(label.label)
+{
+	m_Previous = s_ActiveScope;
+	s_ActiveScope = this;
+	AtomicIncrement(&s_ActiveScopeCount);
+}
+
+RegionAllocatorScope::~RegionAllocatorScope()
+{
+	Assert(s_ActiveScope == this);
+	s_ActiveScope = m_Previous;
+	AtomicDecrement(&s_ActiveScopeCount);
+}
+
+BaseAllocator* RegionAllocatorScope::FindActiveRegion(MemLabelIdentifier label)
+{
+	for (RegionAllocatorScope* scope = s_ActiveScope; scope != NULL; scope = scope->m_Previous)
+	{
+		if (scope->m_Label == label)
+			return scope->m_Region;
+	}
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef REGION_ALLOCATOR_H_
+#define REGION_ALLOCATOR_H_
+
+#if ENABLE_MEMORY_MANAGER
+
+#include "BaseAllocator.h"
+#include "Mutex.h"
+#include "LowLevelDefaultAllocator.h"
+#include "ThreadSpecificValue.h"
+
+// Released chunks are filled with a pattern and kept until the next Release or destruction.
+// Freeing or reallocating a pointer into them, or writing to them, is reported as a pointer
+// that escaped the region.
+#ifndef ENABLE_REGION_ALLOCATOR_ESCAPE_CHECK
+#define ENABLE_REGION_ALLOCATOR_ESCAPE_CHECK DEBUGMODE
+#endif
+
+// Allocator for scene or session scoped data that is thrown away all at once.
+// Allocations are bumped out of chunks requested from LLAllocator, Deallocate does nothing
+// and Release returns every chunk in one go.
+//
+// The region registers itself with the MemoryManager, so pointers into it can be freed
+// with any label. Every chunk's address range is reported as well, so frees of other
+// pointers only look at the regions when they fall between region chunks. A region that
+// can't be registered, because too many exist, fails every allocation.
+// Use RegionAllocatorScope to make it the target of a label.
+
+template<class LLAllocator>
+class RegionAllocator : public BaseAllocator
+{
+public:
+	RegionAllocator(size_t chunkSize, bool useLocking, const char* name);
+	~RegionAllocator();
+
+	virtual void* Allocate (size_t size, int align);
+	virtual void* Reallocate (void* p, size_t size, int align);
+	virtual void  Deallocate (void* p);
+	virtual bool  Contains (const void* p);
+
+	virtual bool CheckIntegrity();
+
+	virtual size_t GetPtrSize(const void* ptr) const;
+
+	// release all allocations made in the region. Nothing may reference them anymore.
+	void Release ();
+
+private:
+	struct Chunk
+	{
+		Chunk*	next;
+		char*	current;
+		char*	end;
+		size_t	size;
+
+		char* GetData() { return (char*)this + kChunkHeaderSize; }
+		bool Contains(const void* p) { return p >= GetData() && p < end; }
+	};
+
+	enum
+	{
+		kChunkHeaderSize = 32,
+		kPoisonValue = 0xDD
+	};
+
+	void* AllocateInChunk (Chunk* chunk, size_t size, int align);
+	Chunk* AddChunk (size_t minSize, bool asCurrent);
+	void ExtendAddressRange (Chunk* chunk);
+	void Lock () { if (m_UseLocking) m_RegionMutex.Lock(); }
+	void Unlock () { if (m_UseLocking) m_RegionMutex.Unlock(); }
+	bool IsReleasedPointer (const void* p); // with m_RegionMutex held
+	void FreeChunks (Chunk* chunks);
+
+	Chunk*	m_Chunks; // newest first, the first one is allocated from
+	Chunk*	m_ReleasedChunks; // kept for the escape check
+	// quick reject for Contains. The chunk lists and the range only change under m_RegionMutex,
+	// even without m_UseLocking, since Contains is called by the threads freeing memory.
+	const char*	m_LowestAddress;
+	const char*	m_HighestAddress;
+	size_t	m_ChunkSize;
+
+	Mutex	m_RegionMutex;
+	bool	m_UseLocking;
+	bool	m_Registered;
+};
+
+// Redirects all allocations the current thread makes with label to region,
+// until the scope ends. Scopes nest, the innermost one for a label wins.
+class RegionAllocatorScope
+{
+public:
+	RegionAllocatorScope(BaseAllocator& region, MemLabelRef label);
+	~RegionAllocatorScope();
+
+	// region the current thread allocates label from, NULL if there is no scope for it
+	static inline BaseAllocator* GetActiveRegion(MemLabelRef label)
+	{
+		// avoids the TLS lookup while no thread uses a region
+		if (s_ActiveScopeCount == 0)
+			return NULL;
+		return FindActiveRegion(label.label);
+	}
+
+private:
+	static BaseAllocator* FindActiveRegion(MemLabelIdentifier label);
+
+	BaseAllocator*			m_Region;
+	MemLabelIdentifier		m_Label;
+	RegionAllocatorScope*	m_Previous;
+
+	static UNITY_TLS_VALUE(RegionAllocatorScope*) s_ActiveScope;
+	static volatile int s_ActiveScopeCount;
+};
+
+#endif
+#endif
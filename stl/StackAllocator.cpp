@@ -3,20 +3,66 @@
 #include "LogAssert.h"
 #include "MemoryManager.h"
 #include "MemoryProfiler.h"
+#include "MemoryUtilities.h"
+#include "AtomicOps.h"
 
-StackAllocator::StackAllocator(int blockSize, const char* name)
+// commit in bigger steps than a page to keep the number of commit calls down
+static const size_t kCommitGranularity = 64*1024;
+
+volatile int StackAllocator::s_MaintenanceFrame = 0;
+volatile int StackAllocator::s_CleanupFrame = 0;
+
+static size_t RoundUpToPageSize(size_t size)
+{
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+	size_t pageMask = GetVirtualMemoryPageSize() - 1;
+	return (size + pageMask) & ~pageMask;
+#else
+	return size;
+#endif
+}
+
+StackAllocator::StackAllocator(int blockSize, const char* name, size_t reserveSize)
 	: BaseAllocator(name)
 	, m_Block(NULL)
-	, m_LastAlloc(NULL)
 	, m_BlockSize(blockSize)
+	, m_LastAlloc(NULL)
+	, m_CommittedSize(blockSize)
+	, m_MinCommittedSize(blockSize)
+	, m_PeakUsedSize(0)
+	, m_IsReserved(false)
+	, m_MaintenanceFrame(s_MaintenanceFrame)
 {
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+	if (reserveSize > (size_t)blockSize)
+	{
+		reserveSize = RoundUpToPageSize(reserveSize);
+		size_t initialSize = RoundUpToPageSize(blockSize);
+		m_Block = (char*)ReserveVirtualMemory(reserveSize);
+		if (m_Block != NULL && CommitVirtualMemory(m_Block, initialSize))
+		{
+			m_IsReserved = true;
+			m_BlockSize = reserveSize;
+			m_CommittedSize = m_MinCommittedSize = initialSize;
+		}
+		else if (m_Block != NULL)
+		{
+			ReleaseVirtualMemory(m_Block, reserveSize);
+			m_Block = NULL;
+		}
+	}
+#endif
+
+	if (!m_IsReserved)
+	{
 #if ENABLE_MEMORY_MANAGER
-	m_Block = (char*)MemoryManager::LowLevelAllocate(m_BlockSize);
+		m_Block = (char*)MemoryManager::LowLevelAllocate(m_BlockSize);
 #else
-	m_Block = (char*)malloc(m_BlockSize);
+		m_Block = (char*)malloc(m_BlockSize);
 #endif
+	}
 
-	m_TotalReservedMemory = blockSize;
+	m_TotalReservedMemory = m_CommittedSize;
 }
 
 StackAllocator::~StackAllocator()
@@ -24,6 +70,14 @@ StackAllocator::~StackAllocator()
 	while(m_LastAlloc)
 		Deallocate(m_LastAlloc);
 
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+	if (m_IsReserved)
+	{
+		ReleaseVirtualMemory(m_Block, m_BlockSize);
+		return;
+	}
+#endif
+
 #if ENABLE_MEMORY_MANAGER
 	MemoryManager::LowLevelFree(m_Block);
 #else
@@ -49,9 +103,9 @@ void* StackAllocator::Allocate (size_t size, int align)
 	char* realPtr;
 
 	char* freePtr = (char*)AlignPtr(GetBufferFreePtr(), align);
-	size_t freeSize = m_BlockSize - (int)(freePtr - m_Block);
+	size_t freeSize = m_BlockSize - (size_t)(freePtr - m_Block);
 
-	if ( InBlock(freePtr) && paddedSize < freeSize )
+	if ( InBlock(freePtr) && paddedSize < freeSize && EnsureCommitted(freePtr + paddedSize) )
 	{
 		realPtr = freePtr;
 	}
@@ -80,12 +134,13 @@ void* StackAllocator::Reallocate (void* p, size_t size, int align)
 		return Allocate(size, align);
 
 	char* freePtr = (char*)AlignPtr(GetBufferFreePtr(), align);
-	size_t freeSize = m_BlockSize - (int)(freePtr - m_Block);
+	size_t freeSize = m_BlockSize - (size_t)(freePtr - m_Block);
 	size_t oldSize = GetPtrSize(p);
 
 	if ((p == m_LastAlloc || oldSize >= size) && InBlock(p) 
 		&& AlignPtr(p,align) == p 
-		&& oldSize + freeSize > size)
+		&& oldSize + freeSize > size
+		&& EnsureCommitted((char*)p + size))
 	{
 		// just expand the top allocation of the stack to the realloc amount
 		Header* h = ( (Header*)p )-1;
@@ -135,6 +190,8 @@ void StackAllocator::Deallocate (void* p)
 
 		if (IsDeleted(m_LastAlloc))
 			Deallocate(m_LastAlloc);
+		else if (m_LastAlloc == NULL)
+			MaintainIfRequested();
 	}
 	else
 	{
@@ -183,6 +240,66 @@ void StackAllocator::UpdateNextHeader(void* before, void* after)
 }
 
 
+bool StackAllocator::CommitInternal(size_t usedSize)
+{
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+	if (!m_IsReserved)
+		return false;
+
+	size_t newCommittedSize = std::max(usedSize, m_CommittedSize + kCommitGranularity);
+	newCommittedSize = std::min(RoundUpToPageSize(newCommittedSize), m_BlockSize);
+	if (newCommittedSize < usedSize || !CommitVirtualMemory(m_Block + m_CommittedSize, newCommittedSize - m_CommittedSize))
+		return false;
+
+	m_TotalReservedMemory += newCommittedSize - m_CommittedSize;
+	m_CommittedSize = newCommittedSize;
+	return true;
+#else
+	return false;
+#endif
+}
+
+size_t StackAllocator::GetUsedBlockSize() const
+{
+	// skip overflow allocations on top of the stack
+	char* ptr = m_LastAlloc;
+	while (ptr != NULL && !InBlock(ptr))
+		ptr = GetPrevAlloc(ptr);
+	if (ptr == NULL)
+		return 0;
+	return ptr + GetPtrSize(ptr) - m_Block;
+}
+
+void StackAllocator::RequestThreadMaintenance(bool cleanup)
+{
+	int frame = AtomicIncrement(&s_MaintenanceFrame);
+	if (cleanup)
+		s_CleanupFrame = frame;
+}
+
+void StackAllocator::FrameMaintenance(bool cleanup)
+{
+	m_MaintenanceFrame = s_MaintenanceFrame;
+#if SUPPORT_VIRTUAL_MEMORY_RESERVE
+	if (!m_IsReserved)
+		return;
+
+	// Keep what this frame needed committed, so a steady workload doesn't
+	// commit and decommit the same pages every frame. Only shrink after a spike.
+	size_t usedSize = GetUsedBlockSize();
+	size_t keepSize = cleanup ? m_MinCommittedSize : std::max(m_MinCommittedSize, m_PeakUsedSize);
+	keepSize = RoundUpToPageSize(std::max(keepSize, usedSize));
+
+	if (keepSize < m_CommittedSize)
+	{
+		DecommitVirtualMemory(m_Block + keepSize, m_CommittedSize - keepSize);
+		m_TotalReservedMemory -= m_CommittedSize - keepSize;
+		m_CommittedSize = keepSize;
+	}
+	m_PeakUsedSize = usedSize;
+#endif
+}
+
 size_t StackAllocator::GetAllocatedMemorySize() const
 {
 	int total = 0;
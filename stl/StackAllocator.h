@@ -6,7 +6,10 @@
 class StackAllocator : public BaseAllocator
 {
 public:
-	StackAllocator(int blocksize, const char* name);
+	// With a reserveSize larger than blocksize, the address range is reserved up front and
+	// pages are committed as the stack grows, so allocations only spill to kMemTempOverflow
+	// once the whole range is in use. FrameMaintenance decommits what is no longer needed.
+	StackAllocator(int blocksize, const char* name, size_t reserveSize = 0);
 	virtual ~StackAllocator ();
 
 	virtual void* Allocate (size_t size, int align);
@@ -20,6 +23,12 @@ public:
 	virtual size_t GetAllocatorSizeTotalUsed() const;
 	virtual size_t GetReservedSizeTotal() const;
 
+	virtual void FrameMaintenance(bool cleanup);
+
+	// Called from the main thread's frame maintenance. Other threads can't be maintained from there,
+	// so each allocator runs its own FrameMaintenance the next time its stack is empty on its own thread.
+	static void RequestThreadMaintenance(bool cleanup);
+
 private:
 	struct Header{
 		int deleted:1;
@@ -28,10 +37,20 @@ private:
 		void* realPtr;
 	};
 	char* m_Block;
-	int m_BlockSize;
+	size_t m_BlockSize;
 
 	char* m_LastAlloc;
 
+	// only differ from m_BlockSize when the block is reserved virtual memory
+	size_t m_CommittedSize;
+	size_t m_MinCommittedSize;
+	size_t m_PeakUsedSize;
+	bool m_IsReserved;
+	int m_MaintenanceFrame;
+
+	static volatile int s_MaintenanceFrame;
+	static volatile int s_CleanupFrame;
+
 	//ThreadID owningThread;
 	bool InBlock ( const void* ptr ) const;
 	bool IsDeleted ( const void* ptr ) const;
@@ -45,6 +64,11 @@ private:
 	UInt32 GetHeaderSize() const;
 
 	void UpdateNextHeader(void* before, void* after);
+
+	bool EnsureCommitted(const char* end);
+	void MaintainIfRequested();
+	bool CommitInternal(size_t usedSize);
+	size_t GetUsedBlockSize() const;
 };
 
 inline bool StackAllocator::Contains (const void* p) 
@@ -94,6 +118,23 @@ inline bool StackAllocator::InBlock(const void* ptr) const
 	return ptr >= m_Block && ptr < (m_Block + m_BlockSize);
 }
 
+inline bool StackAllocator::EnsureCommitted(const char* end)
+{
+	size_t usedSize = end - m_Block;
+	if (usedSize > m_PeakUsedSize)
+		m_PeakUsedSize = usedSize;
+	if (usedSize <= m_CommittedSize)
+		return true;
+	return CommitInternal(usedSize);
+}
+
+inline void StackAllocator::MaintainIfRequested()
+{
+	// the stack is empty, which is this thread's safe point for decommitting
+	if (m_IsReserved && m_MaintenanceFrame != s_MaintenanceFrame)
+		FrameMaintenance(s_CleanupFrame - m_MaintenanceFrame > 0);
+}
+
 inline bool StackAllocator::IsDeleted(const void* ptr ) const
 {
 	if (ptr == NULL)
@@ -38,6 +38,19 @@ template<>      struct CompileTimeAssertImpl<true> {};
 #endif
 
 
+#ifndef SUPPORT_CPP0X_RVALUE_REFERENCES
+#if (defined _MSC_VER) && (_MSC_VER >= 1600)
+#define SUPPORT_CPP0X_RVALUE_REFERENCES 1
+#elif (defined  __has_extension)
+#define SUPPORT_CPP0X_RVALUE_REFERENCES __has_extension(cxx_rvalue_references)
+#elif (defined __GXX_EXPERIMENTAL_CXX0X__) || (__cplusplus >= 201103L)
+#define SUPPORT_CPP0X_RVALUE_REFERENCES 1
+#else
+#define SUPPORT_CPP0X_RVALUE_REFERENCES 0
+#endif
+#endif
+
+
 #if SUPPORT_CPP0X_STATIC_ASSERT && SUPPORT_CPP0X_DECLTYPE
 /// Usage Example:
 /// int a;
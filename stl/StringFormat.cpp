@@ -0,0 +1,383 @@
+#include "UnityPrefix.h"
+#include "StringFormat.h"
+#include <stdio.h>
+
+namespace
+{
+	struct FormatSpec
+	{
+		char	align;		// '<', '>' or 0 for the default of the argument type
+		bool	zeroPad;
+		int		width;
+		int		precision;	// -1 when not given
+		char	type;		// 0 for the default of the argument type
+	};
+
+	// more digits than this make the placeholder invalid instead of overflowing
+	const int kMaxNumberDigits = 6;
+
+	// returns false when there is no digit, value is -1 when there are too many
+	inline bool ParseNumber (const char*& p, int& value)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+		value = 0;
+		int digits = 0;
+		for (; *p >= '0' && *p <= '9'; p++)
+		{
+			if (++digits <= kMaxNumberDigits)
+				value = value * 10 + (*p - '0');
+		}
+		if (digits > kMaxNumberDigits)
+			value = -1;
+		return true;
+	}
+
+	// the part between ':' and '}', returns false for anything it doesn't know
+	bool ParseSpec (const char*& p, FormatSpec& spec)
+	{
+		if (*p == '<' || *p == '>')
+			spec.align = *p++;
+		if (*p == '0')
+		{
+			spec.zeroPad = true;
+			p++;
+		}
+		if (ParseNumber(p, spec.width) && spec.width < 0)
+			return false;
+		if (*p == '.')
+		{
+			p++;
+			if (!ParseNumber(p, spec.precision) || spec.precision < 0)
+				return false;
+		}
+		if (*p != '}')
+		{
+			// strchr finds the terminator as well, a format ending inside the spec stops here
+			if (*p == 0 || strchr("dxXbfegscp", *p) == NULL)
+				return false;
+			spec.type = *p++;
+		}
+		return *p == '}';
+	}
+
+	// digits of value in base 2, 10 or 16, written backwards from end, returns the first digit
+	char* FormatUnsigned (char* end, UInt64 value, int base, bool upperCase)
+	{
+		const char* digits = upperCase ? "0123456789ABCDEF" : "0123456789abcdef";
+		char* p = end;
+		do
+		{
+			*--p = digits[value % base];
+			value /= base;
+		}
+		while (value != 0);
+		return p;
+	}
+}
+
+// Writes what fits into the buffer and counts the whole length
+struct FormatWriter
+{
+	char*	buffer;
+	size_t	size;
+	size_t	length;
+
+	void Put (const char* str, size_t count)
+	{
+		if (length + 1 < size)
+			memcpy(buffer + length, str, std::min(count, size - 1 - length));
+		length += count;
+	}
+
+	void Fill (char c, size_t count)
+	{
+		if (length + 1 < size)
+			memset(buffer + length, c, std::min(count, size - 1 - length));
+		length += count;
+	}
+
+	// pads str to the width of the spec. Numbers padded with zeros keep their sign or 0x in front.
+	void PutPadded (const char* str, size_t count, const FormatSpec& spec, char defaultAlign, size_t prefixLength)
+	{
+		const size_t width = spec.width > 0 ? spec.width : 0;
+		if (count >= width)
+		{
+			Put(str, count);
+			return;
+		}
+
+		const size_t padding = width - count;
+		if (spec.zeroPad && spec.align == 0)
+		{
+			Put(str, prefixLength);
+			Fill('0', padding);
+			Put(str + prefixLength, count - prefixLength);
+		}
+		else if ((spec.align != 0 ? spec.align : defaultAlign) == '<')
+		{
+			Put(str, count);
+			Fill(' ', padding);
+		}
+		else
+		{
+			Fill(' ', padding);
+			Put(str, count);
+		}
+	}
+
+	bool PutArg (const FormatArg& arg, const FormatSpec& spec)
+	{
+		// large enough for 64 binary digits or a double written with %f
+		char text[352];
+		char* const end = text + sizeof(text);
+
+		switch (arg.m_Type)
+		{
+		case FormatArg::kString:
+		{
+			if (spec.type != 0 && spec.type != 's')
+				return false;
+			size_t count = arg.m_Value.s.length;
+			if (spec.precision >= 0 && (size_t)spec.precision < count)
+				count = spec.precision;
+			PutPadded(arg.m_Value.s.str, count, spec, '<', 0);
+			return true;
+		}
+		case FormatArg::kChar:
+			if (spec.type == 0 || spec.type == 'c')
+			{
+				PutPadded(&arg.m_Value.c, 1, spec, '<', 0);
+				return true;
+			}
+			// other types print the character code
+			return PutInteger((SInt64)arg.m_Value.c < 0, (UInt64)(arg.m_Value.c < 0 ? -(SInt64)arg.m_Value.c : arg.m_Value.c), spec, end);
+		case FormatArg::kBool:
+			if (spec.type == 0 || spec.type == 's')
+			{
+				PutPadded(arg.m_Value.b ? "true" : "false", arg.m_Value.b ? 4 : 5, spec, '<', 0);
+				return true;
+			}
+			return PutInteger(false, arg.m_Value.b ? 1 : 0, spec, end);
+		case FormatArg::kSigned:
+		{
+			const SInt64 value = arg.m_Value.i;
+			// negating the smallest value overflows, so it is done on the unsigned value
+			return PutInteger(value < 0, value < 0 ? 0 - (UInt64)value : (UInt64)value, spec, end);
+		}
+		case FormatArg::kUnsigned:
+			return PutInteger(false, arg.m_Value.u, spec, end);
+		case FormatArg::kPointer:
+		{
+			if (spec.type != 0 && spec.type != 'p')
+				return false;
+			char* p = FormatUnsigned(end, (UInt64)(size_t)arg.m_Value.p, 16, false);
+			*--p = 'x';
+			*--p = '0';
+			PutPadded(p, end - p, spec, '>', 2);
+			return true;
+		}
+		case FormatArg::kFloat:
+		{
+			char type = spec.type != 0 ? spec.type : 'g';
+			if (type != 'f' && type != 'e' && type != 'g')
+				return false;
+			char printfFormat[] = { '%', '.', '*', type, 0 };
+			int count = snprintf(text, sizeof(text), printfFormat, spec.precision >= 0 ? std::min(spec.precision, 40) : 6, arg.m_Value.f);
+			count = std::min<int>(count, sizeof(text) - 1);
+			PutPadded(text, count, spec, '>', text[0] == '-' ? 1 : 0);
+			return true;
+		}
+		}
+		return false;
+	}
+
+	bool PutInteger (bool negative, UInt64 value, const FormatSpec& spec, char* end)
+	{
+		char* p;
+		size_t prefixLength = 0;
+		switch (spec.type)
+		{
+		case 0:
+		case 'd': p = FormatUnsigned(end, value, 10, false); break;
+		case 'x': p = FormatUnsigned(end, value, 16, false); break;
+		case 'X': p = FormatUnsigned(end, value, 16, true); break;
+		case 'b': p = FormatUnsigned(end, value, 2, false); break;
+		default: return false;
+		}
+		if (negative)
+		{
+			*--p = '-';
+			prefixLength = 1;
+		}
+		PutPadded(p, end - p, spec, '>', prefixLength);
+		return true;
+	}
+};
+
+size_t FormatArgsTo (char* buffer, size_t size, const char* format, const FormatArg* const* args, int argCount)
+{
+	FormatWriter writer = { buffer, size, 0 };
+	int nextArg = 0;
+	const char* p = format;
+	while (*p != 0)
+	{
+		// copy the text up to the next brace in one go
+		const char* text = p;
+		while (*p != 0 && *p != '{' && *p != '}')
+			p++;
+		writer.Put(text, p - text);
+		if (*p == 0)
+			break;
+
+		if (p[0] == p[1])
+		{
+			// {{ or }}
+			writer.Put(p, 1);
+			p += 2;
+			continue;
+		}
+
+		const char* placeholder = p;
+		p++;
+		bool valid = *placeholder == '{';
+		int argIndex = nextArg;
+		FormatSpec spec = { 0, false, 0, -1, 0 };
+		if (valid)
+		{
+			// {} takes the next argument, {index} doesn't move on
+			if (!ParseNumber(p, argIndex))
+				nextArg++;
+			if (*p == ':')
+				valid = ParseSpec(++p, spec);
+			valid = valid && *p == '}' && argIndex >= 0 && argIndex < argCount;
+		}
+
+		const size_t lengthBefore = writer.length;
+		if (valid)
+			valid = writer.PutArg(*args[argIndex], spec);
+
+		if (!valid)
+		{
+			AssertMsg(false, "Invalid placeholder or missing argument in format string '%s'", format);
+			// write the placeholder as it is
+			writer.length = lengthBefore;
+			if (*placeholder == '}')
+			{
+				writer.Put(placeholder, 1);
+				continue;
+			}
+			while (*p != 0 && *p != '}')
+				p++;
+			if (*p == '}')
+				p++;
+			writer.Put(placeholder, p - placeholder);
+			continue;
+		}
+		p++;
+	}
+
+	if (size > 0)
+		buffer[std::min(writer.length, size - 1)] = 0;
+	return writer.length;
+}
+
+#if ENABLE_UNIT_TESTS
+
+#include "dynamic_array.h"
+#include "Word.h"
+
+double GetTimeSinceStartup();
+
+namespace
+{
+	void CheckFormat (const char* expected, const char* formatted, const char* format)
+	{
+		AssertMsg(strcmp(expected, formatted) == 0, "'%s' formatted to '%s' instead of '%s'", format, formatted, expected);
+	}
+}
+
+void TestStringFormat()
+{
+	char buffer[128];
+	#define CHECK_FORMAT(expected, ...) FormatTo(buffer, sizeof(buffer), __VA_ARGS__); CheckFormat(expected, buffer, #__VA_ARGS__)
+
+	CHECK_FORMAT("plain text", "plain text");
+	CHECK_FORMAT("1 2 3", "{} {} {}", 1, 2u, (SInt64)3);
+	CHECK_FORMAT("-2147483648 18446744073709551615", "{} {}", (int)0x80000000, (UInt64)-1);
+	CHECK_FORMAT("-9223372036854775808", "{}", (SInt64)((UInt64)1 << 63));
+	CHECK_FORMAT("b a b", "{1} {0} {1}", "a", "b");
+	CHECK_FORMAT("{literal} }", "{{literal}} }}");
+	CHECK_FORMAT("ff FF 101 0x00ff", "{:x} {:X} {:b} 0x{:04x}", 255, 255, 5, 255);
+	CHECK_FORMAT("[   42] [42   ] [-0042]", "[{:5}] [{:<5}] [{:05}]", 42, 42, -42);
+	CHECK_FORMAT("[ab   ] [  abc] [abc]", "[{:5}] [{:>5}] [{:.3}]", "ab", "abc", "abcdef");
+	CHECK_FORMAT("0.5 0.333 0.333333 1.000e+00", "{} {:.3} {:f} {:.3e}", 0.5f, 1.0 / 3.0, 1.0 / 3.0, 1.0);
+	CHECK_FORMAT("true false x 120", "{} {} {} {:d}", true, false, 'x', 'x');
+	CHECK_FORMAT("std::string UnityStr small_string", "{} {} {}", std::string("std::string"), UnityStr("UnityStr"), small_string("small_string"));
+
+	// truncation returns the full length like snprintf
+	char small[8];
+	AssertMsg(FormatTo(small, sizeof(small), "{} and {}", 12345, 67890) == 15 && strcmp(small, "12345 a") == 0, "truncated format");
+	AssertMsg(FormatTo(small, sizeof(small), "{:20}", 1) == 20 && strcmp(small, "       ") == 0, "truncated padding");
+
+	// malformed placeholders assert and are written out as they are, without reading past the format or the arguments
+	CHECK_FORMAT("x{:5", "x{:5", 1);
+	CHECK_FORMAT("{:", "{:", 1);
+	CHECK_FORMAT("{0", "{0", 1);
+	CHECK_FORMAT("a{:.}b", "a{:.}b", 1);
+	CHECK_FORMAT("a}b", "a}b", 1);
+	CHECK_FORMAT("{4294967295}", "{4294967295}", 1);
+	CHECK_FORMAT("{99999999999999999999:x}", "{99999999999999999999:x}", 1);
+	CHECK_FORMAT("[{:4294967296}]", "[{:4294967296}]", 1);
+	CHECK_FORMAT("[{:.99999999999f}]", "[{:.99999999999f}]", 1.0);
+	CHECK_FORMAT("1 {1}", "{} {1}", 1);
+
+	// appending to a dynamic_array reuses its capacity
+	dynamic_array<char> text (kMemTempAlloc);
+	for (int i = 0; i < 100; i++)
+		FormatAppend(text, "{},", i);
+	std::string expected;
+	for (int i = 0; i < 100; i++)
+		expected += Format("%d,", i);
+	AssertMsg(text.size() == expected.size() && memcmp(text.data(), expected.data(), text.size()) == 0, "FormatAppend");
+
+	// TempFormat moves to temp memory when the stack buffer is too small
+	std::string longString (1000, 'x');
+	TempFormat shortText ("{} {}", "short", 1);
+	TempFormat longText ("<{}>", longString);
+	AssertMsg(strcmp(shortText.c_str(), "short 1") == 0 && longText.size() == 1002 && longText.c_str()[1001] == '>', "TempFormat");
+
+	#undef CHECK_FORMAT
+}
+
+void BenchmarkStringFormat()
+{
+	const int kCount = 1000000;
+	const std::string name ("Main Camera");
+	size_t sum = 0;
+
+	double t0 = GetTimeSinceStartup();
+	for (int i = 0; i < kCount; i++)
+		sum += Format("%s %d: %d/%d", name.c_str(), i, i & 255, 1024).size();
+	double t1 = GetTimeSinceStartup();
+	char buffer[256];
+	for (int i = 0; i < kCount; i++)
+		sum += FormatTo(buffer, sizeof(buffer), "{} {}: {}/{}", name, i, i & 255, 1024);
+	double t2 = GetTimeSinceStartup();
+	printf_console("integers and a string: Format %.2fms, FormatTo %.2fms for %i strings\n", (t1-t0) * 1000.0, (t2-t1) * 1000.0, kCount);
+
+	t0 = GetTimeSinceStartup();
+	for (int i = 0; i < kCount; i++)
+		sum += Format("%.3f", i * 0.001f).size();
+	t1 = GetTimeSinceStartup();
+	for (int i = 0; i < kCount; i++)
+		sum += FormatTo(buffer, sizeof(buffer), "{:.3f}", i * 0.001f);
+	t2 = GetTimeSinceStartup();
+	printf_console("floats: Format %.2fms, FormatTo %.2fms for %i strings (%i)\n", (t1-t0) * 1000.0, (t2-t1) * 1000.0, kCount, (int)sum);
+
+	// Linux VM, gcc -O2. Floats go through snprintf in both, FormatTo pays for parsing the {} on top of it:
+	// integers and a string: Format 176.55ms, FormatTo 77.99ms for 1000000 strings
+	// floats: Format 238.13ms, FormatTo 266.76ms for 1000000 strings (68698312)
+}
+
+#endif // #if ENABLE_UNIT_TESTS
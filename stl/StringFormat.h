@@ -0,0 +1,182 @@
+#ifndef STRING_FORMAT_H
+#define STRING_FORMAT_H
+
+#include "MemoryMacros.h"
+#include "small_string.h"
+#include <string>
+
+// Type safe formatting with {} placeholders, without allocating:
+//
+//   char buffer[64];
+//   FormatTo (buffer, sizeof(buffer), "{} of {} loaded ({:.1f}%)", count, name, percent);
+//   FormatAppend (charArray, "{:08x}", hash);                   // appends to a dynamic_array<char>
+//   printf_console ("%s\n", TempFormat ("{1} {0}", a, b).c_str()); // stack buffer, longer text goes to kMemTempAlloc
+//
+// Placeholders are {} for the next argument or {index}, with an optional spec {:[<|>][0][width][.precision][type]}:
+//   type d (default for integers), x, X, b, f, e, g (default for floats, 6 digits), s, c, p
+// Strings are left aligned by default, everything else right aligned. {{ and }} write a brace.
+//
+// Every argument is converted to a FormatArg, so passing a type that can't be formatted doesn't compile.
+// The format string is checked while formatting: an unknown spec or a placeholder without an argument asserts
+// and is written out as it is.
+//
+// Up to 8 arguments, more need another FORMAT_ARG_PARAMS_n / FORMAT_ARG_LIST_n and overload line.
+
+class FormatArg
+{
+public:
+	enum Type { kSigned, kUnsigned, kFloat, kString, kChar, kBool, kPointer };
+
+	FormatArg (int value)                    : m_Type (kSigned)   { m_Value.i = value; }
+	FormatArg (long value)                   : m_Type (kSigned)   { m_Value.i = value; }
+	FormatArg (long long value)              : m_Type (kSigned)   { m_Value.i = value; }
+	FormatArg (short value)                  : m_Type (kSigned)   { m_Value.i = value; }
+	FormatArg (signed char value)            : m_Type (kSigned)   { m_Value.i = value; }
+	FormatArg (unsigned int value)           : m_Type (kUnsigned) { m_Value.u = value; }
+	FormatArg (unsigned long value)          : m_Type (kUnsigned) { m_Value.u = value; }
+	FormatArg (unsigned long long value)     : m_Type (kUnsigned) { m_Value.u = value; }
+	FormatArg (unsigned short value)         : m_Type (kUnsigned) { m_Value.u = value; }
+	FormatArg (unsigned char value)          : m_Type (kUnsigned) { m_Value.u = value; }
+	FormatArg (double value)                 : m_Type (kFloat)    { m_Value.f = value; }
+	FormatArg (float value)                  : m_Type (kFloat)    { m_Value.f = value; }
+	FormatArg (bool value)                   : m_Type (kBool)     { m_Value.b = value; }
+	FormatArg (char value)                   : m_Type (kChar)     { m_Value.c = value; }
+	FormatArg (const void* value)            : m_Type (kPointer)  { m_Value.p = value; }
+	FormatArg (const char* value)            : m_Type (kString)   { m_Value.s.str = value != NULL ? value : "(null)"; m_Value.s.length = strlen(m_Value.s.str); }
+	FormatArg (char* value)                  : m_Type (kString)   { m_Value.s.str = value != NULL ? value : "(null)"; m_Value.s.length = strlen(m_Value.s.str); }
+
+	template <typename Alloc>
+	FormatArg (const std::basic_string<char, std::char_traits<char>, Alloc>& value) : m_Type (kString) { m_Value.s.str = value.data(); m_Value.s.length = value.size(); }
+	template <size_t N, MemLabelIdentifier label>
+	FormatArg (const basic_small_string<N, label>& value) : m_Type (kString) { m_Value.s.str = value.data(); m_Value.s.length = value.size(); }
+
+	Type GetType () const { return m_Type; }
+
+private:
+	// Only formatted right away, the argument has to outlive the call like any temporary
+	FormatArg& operator= (const FormatArg&);
+
+	struct StringValue
+	{
+		const char*	str;
+		size_t		length;
+	};
+
+	Type m_Type;
+	union
+	{
+		SInt64		i;
+		UInt64		u;
+		double		f;
+		bool		b;
+		char		c;
+		const void*	p;
+		StringValue	s;
+	} m_Value;
+
+	friend struct FormatWriter;
+};
+
+// Formats into buffer and always terminates it with 0, truncating the text if it doesn't fit.
+// Returns the length of the whole text, like snprintf, so a return value >= size means it was truncated.
+size_t FormatArgsTo (char* buffer, size_t size, const char* format, const FormatArg* const* args, int argCount);
+
+// Appends the formatted text to a dynamic_array<char> (anything with size, resize_uninitialized and data).
+// The characters are not 0 terminated, there is room for the terminator after the end though.
+template <typename CharArray>
+void FormatArgsAppend (CharArray& out, const char* format, const FormatArg* const* args, int argCount)
+{
+	const size_t oldSize = out.size();
+	// format into what is left of the capacity, there is a second pass only when that is too small
+	out.resize_uninitialized(std::max<size_t>(out.capacity(), oldSize + 64));
+	size_t length = FormatArgsTo(out.data() + oldSize, out.size() - oldSize, format, args, argCount);
+	if (oldSize + length >= out.size())
+	{
+		out.resize_uninitialized(oldSize + length + 1);
+		FormatArgsTo(out.data() + oldSize, length + 1, format, args, argCount);
+	}
+	out.resize_uninitialized(oldSize + length);
+}
+
+#define FORMAT_ARG_PARAMS_1 , const FormatArg& a0
+#define FORMAT_ARG_PARAMS_2 FORMAT_ARG_PARAMS_1, const FormatArg& a1
+#define FORMAT_ARG_PARAMS_3 FORMAT_ARG_PARAMS_2, const FormatArg& a2
+#define FORMAT_ARG_PARAMS_4 FORMAT_ARG_PARAMS_3, const FormatArg& a3
+#define FORMAT_ARG_PARAMS_5 FORMAT_ARG_PARAMS_4, const FormatArg& a4
+#define FORMAT_ARG_PARAMS_6 FORMAT_ARG_PARAMS_5, const FormatArg& a5
+#define FORMAT_ARG_PARAMS_7 FORMAT_ARG_PARAMS_6, const FormatArg& a6
+#define FORMAT_ARG_PARAMS_8 FORMAT_ARG_PARAMS_7, const FormatArg& a7
+#define FORMAT_ARG_LIST_1 &a0
+#define FORMAT_ARG_LIST_2 FORMAT_ARG_LIST_1, &a1
+#define FORMAT_ARG_LIST_3 FORMAT_ARG_LIST_2, &a2
+#define FORMAT_ARG_LIST_4 FORMAT_ARG_LIST_3, &a3
+#define FORMAT_ARG_LIST_5 FORMAT_ARG_LIST_4, &a4
+#define FORMAT_ARG_LIST_6 FORMAT_ARG_LIST_5, &a5
+#define FORMAT_ARG_LIST_7 FORMAT_ARG_LIST_6, &a6
+#define FORMAT_ARG_LIST_8 FORMAT_ARG_LIST_7, &a7
+
+// Formatted text that lives on the stack, or in kMemTempAlloc when it is longer than the stack buffer
+class TempFormat
+{
+public:
+	#define FORMAT_TEMP_CONSTRUCTOR(n) \
+	TempFormat (const char* format FORMAT_ARG_PARAMS_##n) : m_Heap (NULL) { const FormatArg* args[] = { FORMAT_ARG_LIST_##n }; Format(format, args, n); }
+
+	TempFormat (const char* format) : m_Heap (NULL) { Format(format, NULL, 0); }
+	FORMAT_TEMP_CONSTRUCTOR(1)
+	FORMAT_TEMP_CONSTRUCTOR(2)
+	FORMAT_TEMP_CONSTRUCTOR(3)
+	FORMAT_TEMP_CONSTRUCTOR(4)
+	FORMAT_TEMP_CONSTRUCTOR(5)
+	FORMAT_TEMP_CONSTRUCTOR(6)
+	FORMAT_TEMP_CONSTRUCTOR(7)
+	FORMAT_TEMP_CONSTRUCTOR(8)
+	#undef FORMAT_TEMP_CONSTRUCTOR
+
+	~TempFormat () { if (m_Heap != NULL) UNITY_FREE(kMemTempAlloc, m_Heap); }
+
+	const char* c_str () const { return m_Heap != NULL ? m_Heap : m_Stack; }
+	size_t size () const { return m_Length; }
+
+private:
+	enum { kStackSize = 256 };
+
+	// Non copyable
+	TempFormat (const TempFormat&);
+	TempFormat& operator= (const TempFormat&);
+
+	void Format (const char* format, const FormatArg* const* args, int argCount)
+	{
+		m_Length = FormatArgsTo(m_Stack, kStackSize, format, args, argCount);
+		if (m_Length >= kStackSize)
+		{
+			m_Heap = static_cast<char*> (UNITY_MALLOC(kMemTempAlloc, m_Length + 1));
+			FormatArgsTo(m_Heap, m_Length + 1, format, args, argCount);
+		}
+	}
+
+	char	m_Stack[kStackSize];
+	char*	m_Heap;
+	size_t	m_Length;
+};
+
+inline size_t FormatTo (char* buffer, size_t size, const char* format) { return FormatArgsTo(buffer, size, format, NULL, 0); }
+template <typename CharArray>
+inline void FormatAppend (CharArray& out, const char* format) { FormatArgsAppend(out, format, NULL, 0); }
+
+#define FORMAT_OVERLOADS(n) \
+inline size_t FormatTo (char* buffer, size_t size, const char* format FORMAT_ARG_PARAMS_##n) { const FormatArg* args[] = { FORMAT_ARG_LIST_##n }; return FormatArgsTo(buffer, size, format, args, n); } \
+template <typename CharArray> \
+inline void FormatAppend (CharArray& out, const char* format FORMAT_ARG_PARAMS_##n) { const FormatArg* args[] = { FORMAT_ARG_LIST_##n }; FormatArgsAppend(out, format, args, n); }
+
+FORMAT_OVERLOADS(1)
+FORMAT_OVERLOADS(2)
+FORMAT_OVERLOADS(3)
+FORMAT_OVERLOADS(4)
+FORMAT_OVERLOADS(5)
+FORMAT_OVERLOADS(6)
+FORMAT_OVERLOADS(7)
+FORMAT_OVERLOADS(8)
+#undef FORMAT_OVERLOADS
+
+#endif
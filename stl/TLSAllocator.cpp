@@ -64,6 +64,10 @@ template <class UnderlyingAllocator>
 void TLSAllocator<UnderlyingAllocator>::FrameMaintenance(bool cleanup)
 {
 	Assert(m_UniqueThreadAllocator->GetAllocatedMemorySize() == 0);
+	// only the calling thread's allocator can be maintained here, other threads may be using theirs.
+	// They maintain themselves the next time their stack is empty.
+	UnderlyingAllocator::RequestThreadMaintenance(cleanup);
+	m_UniqueThreadAllocator->FrameMaintenance(cleanup);
 }
 
 template <class UnderlyingAllocator>
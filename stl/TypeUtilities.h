@@ -18,3 +18,45 @@ inline bool IsOfType (Actual& value)
 {
 	return IsSameType<Actual, Expected>::result;
 }
+
+template<bool value>
+struct BoolToType
+{
+	static const bool result = value;
+};
+
+// True when copying T is a memcpy and destroying it does nothing.
+// __has_trivial_copy is only used by compilers that predate __is_trivially_copyable,
+// it ignores move constructors and deleted copies. Without the intrinsics every type is assumed to be.
+#if defined __clang__
+#if __has_feature(is_trivially_copyable)
+#define HAS_TRIVIAL_COPY_AND_DESTRUCTOR(T) __is_trivially_copyable(T)
+#else
+#define HAS_TRIVIAL_COPY_AND_DESTRUCTOR(T) (__has_trivial_copy(T) && __has_trivial_destructor(T))
+#endif
+#elif (defined _MSC_VER && _MSC_VER >= 1900) || (defined __GNUC__ && __GNUC__ >= 5)
+#define HAS_TRIVIAL_COPY_AND_DESTRUCTOR(T) __is_trivially_copyable(T)
+#elif (defined _MSC_VER) || (defined __GNUC__)
+#define HAS_TRIVIAL_COPY_AND_DESTRUCTOR(T) (__has_trivial_copy(T) && __has_trivial_destructor(T))
+#else
+#define HAS_TRIVIAL_COPY_AND_DESTRUCTOR(T) true
+#endif
+
+template<typename T>
+struct IsTriviallyCopyable
+{
+	static const bool result = HAS_TRIVIAL_COPY_AND_DESTRUCTOR(T);
+};
+
+// True when a T can be moved to another address by copying its bytes, without running its
+// copy constructor and destructor. Containers realloc such types instead of moving each element.
+// Holds for most types with a non trivial copy constructor as well, like smart pointers,
+// but not for types that point into themselves. Opt in with DECLARE_TRIVIALLY_RELOCATABLE.
+template<typename T>
+struct IsTriviallyRelocatable
+{
+	static const bool result = IsTriviallyCopyable<T>::result;
+};
+
+#define DECLARE_TRIVIALLY_RELOCATABLE(T) \
+	template<> struct IsTriviallyRelocatable<T> { static const bool result = true; }
@@ -0,0 +1,287 @@
+#include "UnityPrefix.h"
+#include "concurrent_queue.h"
+#include "ring_buffer.h"
+
+#if ENABLE_UNIT_TESTS
+
+#include "Thread.h"
+#include "Word.h"
+#include <deque>
+
+double GetTimeSinceStartup();
+
+namespace
+{
+	const int kQueueTestCount = 200000;
+
+	struct SPSCTestData
+	{
+		spsc_queue<int>*	queue;
+		int					count;
+	};
+
+	// pushes 0..count-1, mixing single and batch pushes
+	void* SPSCProducer(void* data)
+	{
+		SPSCTestData& test = *static_cast<SPSCTestData*> (data);
+		int batch[7];
+		int next = 0;
+		while (next < test.count)
+		{
+			size_t pushed;
+			if (next % 3 == 0)
+			{
+				int n = 0;
+				for (; n < 7 && next + n < test.count; n++)
+					batch[n] = next + n;
+				pushed = test.queue->push(batch, n);
+			}
+			else
+				pushed = test.queue->push(next) ? 1 : 0;
+
+			next += (int)pushed;
+			if (pushed == 0)
+				Thread::Sleep(0);
+		}
+		return NULL;
+	}
+
+	struct MPMCTestData
+	{
+		mpmc_queue<int>*	queue;
+		int					first;
+		int					count;
+		volatile int*		popped;
+		int*				seen;
+	};
+
+	// pushes first..first+count-1, mixing single and batch pushes
+	void* MPMCProducer(void* data)
+	{
+		MPMCTestData& test = *static_cast<MPMCTestData*> (data);
+		int batch[5];
+		int next = test.first;
+		const int end = test.first + test.count;
+		while (next < end)
+		{
+			size_t pushed;
+			if (next & 1)
+			{
+				int n = 0;
+				for (; n < 5 && next + n < end; n++)
+					batch[n] = next + n;
+				pushed = test.queue->push(batch, n);
+			}
+			else
+				pushed = test.queue->push(next) ? 1 : 0;
+
+			next += (int)pushed;
+			if (pushed == 0)
+				Thread::Sleep(0);
+		}
+		return NULL;
+	}
+
+	// pops until count values were popped by all consumers together
+	void* MPMCConsumer(void* data)
+	{
+		MPMCTestData& test = *static_cast<MPMCTestData*> (data);
+		int batch[4];
+		size_t batchSize = 1;
+		for (;;)
+		{
+			size_t popped = test.queue->pop(batch, batchSize);
+			batchSize = batchSize % 4 + 1;
+			for (size_t i = 0; i < popped; i++)
+				AtomicIncrement((volatile int*)&test.seen[batch[i]]);
+
+			if (popped != 0)
+			{
+				if (AtomicAdd(test.popped, (int)popped) >= test.count)
+					return NULL;
+			}
+			else if (*test.popped >= test.count)
+				return NULL;
+			else
+				Thread::Sleep(0);
+		}
+	}
+}
+
+void TestRingBuffer()
+{
+	ring_buffer<std::string> buffer(5);
+	std::deque<std::string> expected;
+	AssertMsg(buffer.capacity() == 8, "ring_buffer capacity is not rounded up");
+
+	srand(1);
+	for (int i = 0; i < 100000; i++)
+	{
+		// strings longer than any small string buffer, so leaked or double destroyed elements show up
+		std::string value = Format("ring buffer value %d with a long tail", i);
+		std::string values[4];
+		switch (rand() % 6)
+		{
+		case 0:
+		case 1:
+			AssertMsg(buffer.push_back(value) == (expected.size() < 8), "ring_buffer push_back");
+			if (expected.size() < 8)
+				expected.push_back(value);
+			break;
+		case 2:
+			AssertMsg(buffer.pop_front(values[0]) == !expected.empty(), "ring_buffer pop_front");
+			if (!expected.empty())
+			{
+				AssertMsg(values[0] == expected.front(), "ring_buffer pop_front order");
+				expected.pop_front();
+			}
+			break;
+		case 3:
+		{
+			values[0] = values[1] = values[2] = value;
+			size_t pushed = buffer.push_back(values, 3);
+			AssertMsg(pushed == std::min<size_t>(3, 8 - expected.size()), "ring_buffer batch push_back");
+			expected.insert(expected.end(), pushed, value);
+			break;
+		}
+		case 4:
+		{
+			size_t popped = buffer.pop_front(values, 4);
+			AssertMsg(popped == std::min<size_t>(4, expected.size()), "ring_buffer batch pop_front");
+			for (size_t j = 0; j < popped; j++)
+			{
+				AssertMsg(values[j] == expected.front(), "ring_buffer batch pop_front order");
+				expected.pop_front();
+			}
+			break;
+		}
+		default:
+			AssertMsg(buffer.size() == expected.size(), "ring_buffer size");
+			for (size_t j = 0; j < expected.size(); j++)
+				AssertMsg(buffer[j] == expected[j], "ring_buffer operator[]");
+			if (!expected.empty())
+				AssertMsg(buffer.front() == expected.front() && buffer.back() == expected.back(), "ring_buffer front/back");
+			break;
+		}
+	}
+	buffer.clear();
+	AssertMsg(buffer.empty(), "ring_buffer clear");
+}
+
+void TestConcurrentQueue()
+{
+	// a single cell can't work with sequence numbers, the capacity is at least 2
+	mpmc_queue<int> small(1);
+	int value;
+	AssertMsg(small.capacity() == 2, "mpmc_queue capacity");
+	AssertMsg(small.push(1) && small.push(2) && !small.push(3), "mpmc_queue full");
+	AssertMsg(small.pop(value) && value == 1 && small.pop(value) && value == 2 && !small.pop(value), "mpmc_queue empty");
+
+	// one producer and one consumer thread, the values arrive in order
+	{
+		spsc_queue<int> queue(100);
+		SPSCTestData test = { &queue, kQueueTestCount };
+		Thread producer;
+		producer.Run(SPSCProducer, &test);
+
+		int expected = 0;
+		int batch[5];
+		while (expected < kQueueTestCount)
+		{
+			size_t popped = (expected & 1) ? queue.pop(batch, 5) : (queue.pop(batch[0]) ? 1 : 0);
+			for (size_t i = 0; i < popped; i++, expected++)
+				AssertMsg(batch[i] == expected, "spsc_queue lost or reordered a value");
+			if (popped == 0)
+				Thread::Sleep(0);
+		}
+		producer.WaitForExit();
+		AssertMsg(queue.empty(), "spsc_queue not empty");
+	}
+
+	// two producers and two consumers, every value is popped exactly once
+	{
+		mpmc_queue<int> queue(64);
+		dynamic_array<int> seen(kQueueTestCount, kMemTempAlloc);
+		memset(seen.data(), 0, kQueueTestCount * sizeof(int));
+		volatile int popped = 0;
+
+		MPMCTestData test[2];
+		Thread producers[2], consumers[2];
+		for (int i = 0; i < 2; i++)
+		{
+			MPMCTestData data = { &queue, i * kQueueTestCount / 2, kQueueTestCount / 2, &popped, seen.data() };
+			test[i] = data;
+			producers[i].Run(MPMCProducer, &test[i]);
+		}
+		MPMCTestData consumerData = { &queue, 0, kQueueTestCount, &popped, seen.data() };
+		for (int i = 0; i < 2; i++)
+			consumers[i].Run(MPMCConsumer, &consumerData);
+		for (int i = 0; i < 2; i++)
+		{
+			producers[i].WaitForExit();
+			consumers[i].WaitForExit();
+		}
+
+		for (int i = 0; i < kQueueTestCount; i++)
+			AssertMsg(seen[i] == 1, "mpmc_queue popped %d %d times", i, seen[i]);
+		AssertMsg(queue.empty(), "mpmc_queue not empty");
+	}
+}
+
+void BenchmarkConcurrentQueue()
+{
+	const int kCount = 4000000;
+	double t0 = GetTimeSinceStartup();
+	{
+		spsc_queue<int> queue(1024);
+		SPSCTestData test = { &queue, kCount };
+		Thread producer;
+		producer.Run(SPSCProducer, &test);
+		int value, popped = 0;
+		while (popped < kCount)
+		{
+			if (queue.pop(value))
+				popped++;
+			else
+				Thread::Sleep(0);
+		}
+		producer.WaitForExit();
+	}
+	double t1 = GetTimeSinceStartup();
+	printf_console("spsc_queue: %.2fs for %i values (%.1f M/s), 1 producer 1 consumer\n", t1-t0, kCount, kCount / (t1-t0) / 1000000.0);
+
+	for (int threads = 1; threads <= 4; threads *= 2)
+	{
+		mpmc_queue<int> queue(1024);
+		dynamic_array<int> seen(kCount, kMemTempAlloc);
+		memset(seen.data(), 0, kCount * sizeof(int));
+		volatile int popped = 0;
+
+		t0 = GetTimeSinceStartup();
+		MPMCTestData test[4];
+		Thread producers[4], consumers[4];
+		MPMCTestData consumerData = { &queue, 0, kCount, &popped, seen.data() };
+		for (int i = 0; i < threads; i++)
+		{
+			MPMCTestData data = { &queue, i * (kCount / threads), kCount / threads, &popped, seen.data() };
+			test[i] = data;
+			producers[i].Run(MPMCProducer, &test[i]);
+			consumers[i].Run(MPMCConsumer, &consumerData);
+		}
+		for (int i = 0; i < threads; i++)
+		{
+			producers[i].WaitForExit();
+			consumers[i].WaitForExit();
+		}
+		t1 = GetTimeSinceStartup();
+		printf_console("mpmc_queue: %.2fs for %i values (%.1f M/s), %i producers %i consumers\n", t1-t0, kCount, kCount / (t1-t0) / 1000000.0, threads, threads);
+	}
+
+	// Linux VM with a single core, gcc -O2. The threads take turns, so this is the cost without contention:
+	// spsc_queue: 0.03s for 4000000 values (133.9 M/s), 1 producer 1 consumer
+	// mpmc_queue: 0.13s for 4000000 values (30.1 M/s), 1 producers 1 consumers
+	// mpmc_queue: 0.13s for 4000000 values (29.8 M/s), 2 producers 2 consumers
+	// mpmc_queue: 0.12s for 4000000 values (32.3 M/s), 4 producers 4 consumers
+}
+
+#endif // #if ENABLE_UNIT_TESTS
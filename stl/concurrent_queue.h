@@ -0,0 +1,302 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "AtomicOps.h"
+#include "BitUtility.h"
+#include <algorithm>
+
+// spsc_queue - bounded queue for one producer and one consumer thread
+// mpmc_queue - bounded queue for any number of producer and consumer threads
+//
+// features:
+//  . one allocation from the memory label when constructed, push and pop never allocate or lock
+//  . the capacity is rounded up to a power of two. push returns false when the queue is full, pop returns false when it is empty,
+//		the caller decides whether to spin, sleep or drop
+//  . spsc_queue is wait-free: push and pop finish in a bounded number of steps. Each side keeps a copy of the other
+//		side's position and only reads the shared one when the copy says full or empty.
+//  . mpmc_queue uses a sequence number per cell (Dmitry Vyukov's bounded queue): a producer or consumer claims a position
+//		with one compare exchange and then only touches its own cell, so there is no ABA problem
+//  . batch push/pop move count values with one claim
+//  . positions written by different threads are kept kCacheLineSize apart
+//  . elements have to be trivially copyable, they are copied in and out of the cells
+//
+template <typename T, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+class spsc_queue
+{
+public:
+	typedef T value_type;
+
+	explicit spsc_queue(size_t capacity) : m_label(defaultLabel, NULL)
+	{
+		m_label = MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER());
+		allocate(capacity);
+	}
+
+	spsc_queue(size_t capacity, MemLabelRef label) : m_label(label)
+	{
+		allocate(capacity);
+	}
+
+	~spsc_queue()
+	{
+		UNITY_FREE(m_label, m_data);
+	}
+
+	// producer thread only. Returns false if the queue is full.
+	bool push(const T& value)
+	{
+		UInt32 write = m_write;
+		if (write - m_cachedRead > m_mask)
+		{
+			m_cachedRead = AtomicLoadAcquire(&m_read);
+			if (write - m_cachedRead > m_mask)
+				return false;
+		}
+		m_data[write & m_mask] = value;
+		AtomicStoreRelease(&m_write, (int)(write + 1));
+		return true;
+	}
+
+	// producer thread only. Pushes as many of the values as fit, returns how many were pushed.
+	size_t push(const T* values, size_t count)
+	{
+		UInt32 write = m_write;
+		if (write - m_cachedRead + count > m_mask + 1)
+			m_cachedRead = AtomicLoadAcquire(&m_read);
+		count = std::min<size_t>(count, m_mask + 1 - (write - m_cachedRead));
+		for (size_t i = 0; i < count; i++)
+			m_data[(write + i) & m_mask] = values[i];
+		AtomicStoreRelease(&m_write, (int)(write + count));
+		return count;
+	}
+
+	// consumer thread only. Returns false if the queue is empty.
+	bool pop(T& value)
+	{
+		UInt32 read = m_read;
+		if (read == m_cachedWrite)
+		{
+			m_cachedWrite = AtomicLoadAcquire(&m_write);
+			if (read == m_cachedWrite)
+				return false;
+		}
+		value = m_data[read & m_mask];
+		AtomicStoreRelease(&m_read, (int)(read + 1));
+		return true;
+	}
+
+	// consumer thread only. Pops up to count values, returns how many were popped.
+	size_t pop(T* values, size_t count)
+	{
+		UInt32 read = m_read;
+		if (m_cachedWrite - read < count)
+			m_cachedWrite = AtomicLoadAcquire(&m_write);
+		count = std::min<size_t>(count, m_cachedWrite - read);
+		for (size_t i = 0; i < count; i++)
+			values[i] = m_data[(read + i) & m_mask];
+		AtomicStoreRelease(&m_read, (int)(read + count));
+		return count;
+	}
+
+	// exact on the producer and consumer thread when the other one is idle, a snapshot otherwise
+	size_t size() const
+	{
+		// the write position never falls behind the read position, so read that first
+		UInt32 read = m_read;
+		return (UInt32)m_write - read;
+	}
+	bool empty() const { return size() == 0; }
+	size_t capacity() const { return m_mask + 1; }
+
+private:
+	// Non copyable
+	spsc_queue(const spsc_queue&);
+	spsc_queue& operator=(const spsc_queue&);
+
+	void allocate(size_t capacity)
+	{
+		CompileTimeAssert(IsTriviallyCopyable<T>::result, "spsc_queue elements have to be trivially copyable");
+		Assert(capacity > 0 && capacity <= (1U << 30));
+		m_mask = NextPowerOfTwo((UInt32)capacity) - 1;
+		m_data = static_cast<T*> (UNITY_MALLOC_ALIGNED(m_label, (m_mask + 1) * sizeof(T), std::max<int>(AlignOfType<T>::align, kCacheLineSize)));
+		m_write = m_cachedRead = 0;
+		m_read = m_cachedWrite = 0;
+	}
+
+	// read by both threads, never written after construction
+	T*				m_data;
+	UInt32			m_mask;
+	MemLabelId		m_label;
+
+	char			m_producerPadding[kCacheLineSize];
+	volatile int	m_write;
+	UInt32			m_cachedRead;
+
+	char			m_consumerPadding[kCacheLineSize];
+	volatile int	m_read;
+	UInt32			m_cachedWrite;
+
+	char			m_endPadding[kCacheLineSize];
+};
+
+
+template <typename T, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+class mpmc_queue
+{
+public:
+	typedef T value_type;
+
+	explicit mpmc_queue(size_t capacity) : m_label(defaultLabel, NULL)
+	{
+		m_label = MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER());
+		allocate(capacity);
+	}
+
+	mpmc_queue(size_t capacity, MemLabelRef label) : m_label(label)
+	{
+		allocate(capacity);
+	}
+
+	~mpmc_queue()
+	{
+		UNITY_FREE(m_label, m_cells);
+	}
+
+	// Returns false if the queue is full
+	bool push(const T& value) { return push(&value, 1) == 1; }
+
+	// Pushes as many of the values as there are free cells in a row, returns how many were pushed.
+	// Less than count are pushed when the queue is nearly full or a consumer is still reading the next cell.
+	size_t push(const T* values, size_t count)
+	{
+		if (count == 0)
+			return 0;
+
+		// A cell is free for position pos when its sequence is pos. Consumers finish in any order,
+		// so every cell of the batch is checked before it is claimed.
+		UInt32 pos = m_enqueuePos;
+		UInt32 claimed;
+		for (;;)
+		{
+			claimed = 0;
+			while (claimed < count && (int)(AtomicLoadAcquire(&cell(pos + claimed).sequence) - (pos + claimed)) == 0)
+				claimed++;
+
+			if (claimed == 0)
+			{
+				int diff = (int)(AtomicLoadAcquire(&cell(pos).sequence) - pos);
+				// the cell still holds a value from the previous lap: full
+				if (diff < 0)
+					return 0;
+				// another producer took pos already
+				pos = m_enqueuePos;
+				continue;
+			}
+
+			if (AtomicCompareExchange(&m_enqueuePos, (int)(pos + claimed), (int)pos))
+				break;
+			pos = m_enqueuePos;
+		}
+
+		for (size_t i = 0; i < claimed; i++)
+		{
+			Cell& c = cell(pos + i);
+			c.value = values[i];
+			AtomicStoreRelease(&c.sequence, (int)(pos + i + 1));
+		}
+		return claimed;
+	}
+
+	// Returns false if the queue is empty
+	bool pop(T& value) { return pop(&value, 1) == 1; }
+
+	// Pops up to count values that were pushed in a row, returns how many were popped
+	size_t pop(T* values, size_t count)
+	{
+		if (count == 0)
+			return 0;
+
+		// A cell holds the value for position pos when its sequence is pos + 1
+		UInt32 pos = m_dequeuePos;
+		UInt32 claimed;
+		for (;;)
+		{
+			claimed = 0;
+			while (claimed < count && (int)(AtomicLoadAcquire(&cell(pos + claimed).sequence) - (pos + claimed + 1)) == 0)
+				claimed++;
+
+			if (claimed == 0)
+			{
+				int diff = (int)(AtomicLoadAcquire(&cell(pos).sequence) - (pos + 1));
+				// nothing was pushed to pos yet: empty
+				if (diff < 0)
+					return 0;
+				// another consumer took pos already
+				pos = m_dequeuePos;
+				continue;
+			}
+
+			if (AtomicCompareExchange(&m_dequeuePos, (int)(pos + claimed), (int)pos))
+				break;
+			pos = m_dequeuePos;
+		}
+
+		for (size_t i = 0; i < claimed; i++)
+		{
+			Cell& c = cell(pos + i);
+			values[i] = c.value;
+			// free the cell for the producer of the next lap
+			AtomicStoreRelease(&c.sequence, (int)(pos + i + m_mask + 1));
+		}
+		return claimed;
+	}
+
+	// a snapshot, other threads may push and pop at the same time
+	size_t size() const
+	{
+		UInt32 dequeuePos = m_dequeuePos;
+		int size = (int)((UInt32)m_enqueuePos - dequeuePos);
+		return size > 0 ? size : 0;
+	}
+	bool empty() const { return size() == 0; }
+	size_t capacity() const { return m_mask + 1; }
+
+private:
+	// Non copyable
+	mpmc_queue(const mpmc_queue&);
+	mpmc_queue& operator=(const mpmc_queue&);
+
+	struct Cell
+	{
+		volatile int	sequence;
+		T				value;
+	};
+
+	Cell& cell(UInt32 pos) const { return m_cells[pos & m_mask]; }
+
+	void allocate(size_t capacity)
+	{
+		CompileTimeAssert(IsTriviallyCopyable<T>::result, "mpmc_queue elements have to be trivially copyable");
+		Assert(capacity > 0 && capacity <= (1U << 30));
+		// with one cell a full cell can't be told from a free one
+		m_mask = std::max<UInt32>(NextPowerOfTwo((UInt32)capacity), 2) - 1;
+		m_cells = static_cast<Cell*> (UNITY_MALLOC_ALIGNED(m_label, (m_mask + 1) * sizeof(Cell), std::max<int>(AlignOfType<Cell>::align, kCacheLineSize)));
+		for (UInt32 i = 0; i <= m_mask; i++)
+			m_cells[i].sequence = i;
+		m_enqueuePos = 0;
+		m_dequeuePos = 0;
+	}
+
+	// read by all threads, never written after construction
+	Cell*			m_cells;
+	UInt32			m_mask;
+	MemLabelId		m_label;
+
+	char			m_enqueuePadding[kCacheLineSize];
+	volatile int	m_enqueuePos;
+
+	char			m_dequeuePadding[kCacheLineSize];
+	volatile int	m_dequeuePos;
+
+	char			m_endPadding[kCacheLineSize];
+};
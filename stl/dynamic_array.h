@@ -4,28 +4,35 @@
 #include "StaticAssert.h"
 
 #include <memory> // std::uninitialized_fill
+#include <new> // placement new
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+#include <utility> // std::move, std::forward
+#endif
 #define DebugAssert(x)
 #define Assert(x)
 // dynamic_array - simplified version of std::vector<T>
 //
 // features:
-//  . always uses memcpy for copying elements. Your data structures must be simple and can't have internal pointers / rely on copy constructor.
+//  . uses memcpy for copying elements that are trivially copyable, and realloc for growing arrays of trivially relocatable
+//		elements (see TypeUtilities.h). Other types are copy/move constructed and destroyed like in std::vector.
 //  . EASTL like push_back(void) implementation
 //		Existing std STL implementations implement insertion operations by copying from an element.
 //		For example, resize(size() + 1) creates a throw-away temporary object.
 //		There is no way in existing std STL implementations to add an element to a container without implicitly or
 //			explicitly providing one to copy from (aside from some existing POD optimizations).
 //		For expensive-to-construct objects this creates a potentially serious performance problem.
-//  . grows X2 on reallocation
+//  . grows X2 on reallocation, or by growthPercent (150 grows X1.5)
 //  . small code footprint
 //  . clear actually deallocates memory
-//  . resize does NOT initialize members!
+//  . resize does NOT initialize members! (unless they are not trivially copyable, those are default constructed)
 //
 //	Changelog:
 //		Added pop_back()
 //		Added assign()
 //		Added clear() - frees the data, use resize(0) to clear w/o freeing
 //		zero allocation for empty array
+//		Added move construction/assignment, emplace_back() and non-POD elements
+//		Added growthPercent
 //
 //
 template<typename T>
@@ -35,7 +42,22 @@ struct AlignOfType
 };
 
 
-template <typename T, size_t align = AlignOfType<T>::align, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+#ifndef DYNAMIC_ARRAY_GROWTH_PERCENT
+#define DYNAMIC_ARRAY_GROWTH_PERCENT 200
+#endif
+
+// emplace_back forwards its arguments where rvalue references are available and passes them by const reference otherwise
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+#define DYNAMIC_ARRAY_ARG(A, a) A&& a
+#define DYNAMIC_ARRAY_FORWARD(A, a) std::forward<A>(a)
+#define DYNAMIC_ARRAY_MOVE(a) std::move(a)
+#else
+#define DYNAMIC_ARRAY_ARG(A, a) const A& a
+#define DYNAMIC_ARRAY_FORWARD(A, a) a
+#define DYNAMIC_ARRAY_MOVE(a) a
+#endif
+
+template <typename T, size_t align = AlignOfType<T>::align, MemLabelIdentifier defaultLabel = kMemDynamicArrayId, size_t growthPercent = DYNAMIC_ARRAY_GROWTH_PERCENT>
 struct dynamic_array
 {
 public:
@@ -59,13 +81,14 @@ public:
 	}
 
 	explicit dynamic_array (size_t size, MemLabelRef label)
-		:   m_label(label), m_size(size), m_capacity (size)
+		:   m_data(NULL), m_label(label), m_size(size), m_capacity (size)
 	{
 		m_data = allocate (size);
+		construct_default (m_data, m_data + size);
 	}
 
 	dynamic_array (size_t size, T const& init_value, MemLabelRef label)
-		:	m_label(label), m_size (size), m_capacity (size)
+		:	m_data(NULL), m_label(label), m_size (size), m_capacity (size)
 	{
 		m_data = allocate (size);
 		std::uninitialized_fill (m_data, m_data + size, init_value);
@@ -74,27 +97,62 @@ public:
 	~dynamic_array()
 	{
 		if (owns_data())
+		{
+			destroy(m_data, m_data + m_size);
 			m_data = deallocate(m_data);
+		}
 	}
 
-	dynamic_array(const dynamic_array& other) : m_capacity(0), m_size(0), m_label(other.m_label)
+	dynamic_array(const dynamic_array& other) : m_data(NULL), m_label(other.m_label), m_size(0), m_capacity(0)
 	{
 		//m_label.SetRootHeader(GET_CURRENT_ALLOC_ROOT_HEADER());
-		m_data = NULL;
 		assign(other.begin(), other.end());
 	}
 
 	dynamic_array& operator=(const dynamic_array& other)
 	{
 		// should not allocate memory unless we have to
-		assign(other.begin(), other.end());
+		if (&other != this)
+			assign(other.begin(), other.end());
+		return *this;
+	}
+
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	// takes over the memory and the label of other, which is left empty
+	dynamic_array(dynamic_array&& other) : m_data(NULL), m_label(other.m_label), m_size(0), m_capacity(0)
+	{
+		take_data(other);
+	}
+
+	dynamic_array& operator=(dynamic_array&& other)
+	{
+		if (&other != this)
+		{
+			clear();
+			m_label = other.m_label;
+			take_data(other);
+		}
 		return *this;
 	}
+#endif
 
+	// inline storage (see small_dynamic_array) stays in use, other data is freed or released
 	void clear()
 	{
+		if (m_capacity & k_inline_bit)
+		{
+			destroy(m_data, m_data + m_size);
+			m_size = 0;
+			return;
+		}
+
 		if (owns_data())
-			m_data = deallocate(m_data);
+		{
+			destroy(m_data, m_data + m_size);
+			deallocate(m_data);
+		}
+		// external data is left to its owner, the array doesn't point at it any more
+		m_data = NULL;
 		m_size = 0;
 		m_capacity = 0;
 	}
@@ -103,8 +161,18 @@ public:
 	{
 		Assert(begin<=end);
 
-		resize_uninitialized(end-begin);
-		memcpy(m_data, begin, m_size * sizeof(T));
+		if (IsTriviallyCopyable<T>::result)
+		{
+			resize_uninitialized(end-begin);
+			copy_construct(m_data, begin, end);
+			return;
+		}
+
+		destroy(m_data, m_data + m_size);
+		m_size = 0;
+		reserve(end-begin);
+		copy_construct(m_data, begin, end);
+		m_size = end-begin;
 	}
 
 	void erase(iterator input_begin, iterator input_end)
@@ -113,8 +181,7 @@ public:
 		Assert(input_begin >= begin());
 		Assert(input_end <= end());
 
-		size_t leftOverSize = end() - input_end;
-		memmove(input_begin, input_end, leftOverSize * sizeof(T));
+		erase_range(input_begin, input_end, end(), BoolToType<IsTriviallyRelocatable<T>::result>());
 		m_size -= input_end - input_begin;
 	}
 
@@ -123,10 +190,7 @@ public:
 		Assert(position >= begin());
 		Assert(position < end());
 
-		size_t leftOverSize = end() - position - 1;
-		memmove(position, position+1, leftOverSize * sizeof(T));
-		m_size -= 1;
-
+		erase(position, position+1);
 		return position;
 	}
 
@@ -136,17 +200,18 @@ public:
 		Assert(insert_before >= begin());
 		Assert(insert_before <= end());
 
-		// resize (make sure that insertBefore does not get invalid in the meantime because of a reallocation)
+		size_t insertsize = input_end - input_begin;
+		if (insertsize == 0)
+			return insert_before;
+
+		// reserve (make sure that insertBefore does not get invalid in the meantime because of a reallocation)
 		size_t insert_before_index = insert_before - begin();
-		size_t elements_to_be_moved = size() - insert_before_index;
-		resize_uninitialized((input_end - input_begin) + size());
+		size_t old_size = m_size;
+		reserve(old_size + insertsize);
 		insert_before = begin() + insert_before_index;
 
-		size_t insertsize = input_end - input_begin;
-		// move to the end of where the inserted data will be
-		memmove(insert_before + insertsize, insert_before, elements_to_be_moved * sizeof(T));
-		// inject input data in the hole we just created
-		memcpy(insert_before, input_begin, insertsize * sizeof(T));
+		insert_range(insert_before_index, input_begin, input_end, BoolToType<IsTriviallyRelocatable<T>::result>());
+		m_size = old_size + insertsize;
 
 		return insert_before;
 	}
@@ -155,6 +220,19 @@ public:
 
 	void swap(dynamic_array& other) throw()
 	{
+		if ((m_capacity | other.m_capacity) & k_inline_bit)
+		{
+			// inline storage can't change owner, its elements go through a temporary
+			MemLabelId label = m_label;
+			dynamic_array temp(label);
+			temp.take_data(*this);
+			m_label = other.m_label;
+			take_data(other);
+			other.m_label = label;
+			other.take_data(temp);
+			return;
+		}
+
 		if (m_data) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(m_data, m_label, other.m_label.GetRootHeader());
 		if (other.m_data) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(other.m_data, other.m_label, m_label.GetRootHeader());
 		std::swap(m_data, other.m_data);
@@ -165,45 +243,112 @@ public:
 
 	T& push_back()
 	{
-		if (++m_size > capacity())
-			reserve(std::max<size_t>(capacity()*2, 1));
-		return back();
+		if (m_size == capacity())
+			reserve(grown_capacity(m_size + 1));
+		construct_default(m_data + m_size, m_data + m_size + 1);
+		return m_data[m_size++];
 	}
 
 	void push_back(const T& t)
 	{
-		push_back() = t;
+		if (m_size == capacity())
+		{
+			// t may live in this array, find it again after growing
+			bool inside = &t >= begin() && &t < end();
+			size_t index = inside ? &t - m_data : 0;
+			reserve(grown_capacity(m_size + 1));
+			new (m_data + m_size) T(inside ? m_data[index] : t);
+		}
+		else
+			new (m_data + m_size) T(t);
+		m_size++;
+	}
+
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	void push_back(T&& t)
+	{
+		if (m_size == capacity())
+		{
+			// t may live in this array, find it again after growing
+			bool inside = &t >= begin() && &t < end();
+			size_t index = inside ? &t - m_data : 0;
+			reserve(grown_capacity(m_size + 1));
+			new (m_data + m_size) T(std::move(inside ? m_data[index] : t));
+		}
+		else
+			new (m_data + m_size) T(std::move(t));
+		m_size++;
+	}
+#endif
+
+	// constructs the element in place. The arguments may not refer to elements of this array.
+	T& emplace_back()
+	{
+		new (prepare_emplace()) T();
+		return m_data[m_size++];
+	}
+
+	template<class A1>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1))
+	{
+		new (prepare_emplace()) T(DYNAMIC_ARRAY_FORWARD(A1, a1));
+		return m_data[m_size++];
+	}
+
+	template<class A1, class A2>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1), DYNAMIC_ARRAY_ARG(A2, a2))
+	{
+		new (prepare_emplace()) T(DYNAMIC_ARRAY_FORWARD(A1, a1), DYNAMIC_ARRAY_FORWARD(A2, a2));
+		return m_data[m_size++];
+	}
+
+	template<class A1, class A2, class A3>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1), DYNAMIC_ARRAY_ARG(A2, a2), DYNAMIC_ARRAY_ARG(A3, a3))
+	{
+		new (prepare_emplace()) T(DYNAMIC_ARRAY_FORWARD(A1, a1), DYNAMIC_ARRAY_FORWARD(A2, a2), DYNAMIC_ARRAY_FORWARD(A3, a3));
+		return m_data[m_size++];
+	}
+
+	template<class A1, class A2, class A3, class A4>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1), DYNAMIC_ARRAY_ARG(A2, a2), DYNAMIC_ARRAY_ARG(A3, a3), DYNAMIC_ARRAY_ARG(A4, a4))
+	{
+		new (prepare_emplace()) T(DYNAMIC_ARRAY_FORWARD(A1, a1), DYNAMIC_ARRAY_FORWARD(A2, a2), DYNAMIC_ARRAY_FORWARD(A3, a3), DYNAMIC_ARRAY_FORWARD(A4, a4));
+		return m_data[m_size++];
 	}
 
 	void pop_back()
 	{
 		Assert(m_size >= 1);
 		m_size--;
+		destroy(m_data + m_size, m_data + m_size + 1);
 	}
 
+	// double_on_resize grows the capacity by growthPercent instead of to exactly size
 	void resize_uninitialized(size_t size, bool double_on_resize = false)
 	{
-		m_size = size;
-		if (m_size <= capacity())
-			return;
+		if (size > capacity())
+			reserve(double_on_resize ? grown_capacity(size) : size);
 
-		if(double_on_resize && size < capacity()*2)
-			size = capacity()*2;
-		reserve(size);
+		if (size > m_size)
+			construct_default(m_data + m_size, m_data + size);
+		else
+			destroy(m_data + size, m_data + m_size);
+		m_size = size;
 	}
 
 	void resize_initialized(size_t size, const T& t = T(), bool double_on_resize = false)
 	{
 		if (size > capacity())
 		{
-			size_t requested_size = size;
-			if(double_on_resize && size < capacity()*2)
-				requested_size = capacity()*2;
-			reserve(requested_size);
+			// t may live in this array
+			T value(t);
+			reserve(double_on_resize ? grown_capacity(size) : size);
+			std::uninitialized_fill (m_data + m_size, m_data + size, value);
 		}
-
-		if (size > m_size)
+		else if (size > m_size)
 			std::uninitialized_fill (m_data + m_size, m_data + size, t);
+		else
+			destroy(m_data + size, m_data + m_size);
 		m_size = size;
 	}
 
@@ -212,24 +357,7 @@ public:
 		if (capacity() >= inCapacity)
 			return;
 
-		if (owns_data())
-		{
-			m_capacity = inCapacity;
-			m_data = reallocate(m_data, inCapacity);
-		}
-		else
-		{
-			T* newData = allocate(inCapacity);
-			memcpy(newData, m_data, m_size * sizeof(T));
-
-			// Invalidate old non-owned data, since using the data from two places is most likely a really really bad idea.
-#if DEBUGMODE
-			memset(m_data, 0xCD, capacity() * sizeof(T));
-#endif
-
-			m_capacity = inCapacity; // and clear reference bit
-			m_data = newData;
-		}
+		relocate(inCapacity);
 	}
 
 	void assign_external (T* begin, T* end)
@@ -237,13 +365,14 @@ public:
 		if (owns_data())
 			m_data = deallocate(m_data);
 		m_size = m_capacity = reinterpret_cast<value_type*> (end) - reinterpret_cast<value_type*> (begin);
-		Assert(m_size < k_reference_bit);
+		Assert(m_size < k_inline_bit);
 		m_capacity |= k_reference_bit;
 		m_data = begin;
 	}
 
 	void set_owns_data (bool ownsData)
 	{
+		Assert(!ownsData || !(m_capacity & k_inline_bit));
 		if (ownsData)
 			m_capacity &= ~k_reference_bit;
 		else
@@ -252,11 +381,8 @@ public:
 
 	void shrink_to_fit()
 	{
-		if (owns_data())
-		{
-			m_capacity = m_size;
-			m_data = reallocate(m_data, m_size);
-		}
+		if (owns_data() && m_size != capacity())
+			relocate(m_size);
 	}
 
 	const T& back() const { Assert (m_size != 0); return m_data[m_size - 1]; }
@@ -270,7 +396,7 @@ public:
 
 	bool empty () const { return m_size == 0; }
 	size_t size() const { return m_size; }
-	size_t capacity() const { return m_capacity & ~k_reference_bit; }
+	size_t capacity() const { return m_capacity & ~(k_reference_bit | k_inline_bit); }
 
 	T const& operator[] (size_t index) const { DebugAssert(index < m_size); return m_data[index]; }
 	T& operator[] (size_t index) { DebugAssert(index < m_size); return m_data[index]; }
@@ -303,9 +429,168 @@ public:
 		m_label = label;
 	}
 
-private:
+protected:
 
 	static const size_t k_reference_bit = (size_t)1 << (sizeof (size_t) * 8 - 1);
+	// set together with k_reference_bit when m_data is storage inside the object, which can't be handed to another array
+	static const size_t k_inline_bit = (size_t)1 << (sizeof (size_t) * 8 - 2);
+
+	// moves the elements of other into this empty array and leaves other empty, the labels are up to the caller.
+	// The memory of other is taken over, unless it is inline storage or the elements fit into the inline storage
+	// of this array, then they are copied.
+	void take_data(dynamic_array& other)
+	{
+		Assert(m_size == 0 && (m_data == NULL || (m_capacity & k_inline_bit)));
+		if ((other.m_capacity & k_inline_bit) || ((m_capacity & k_inline_bit) && other.m_size <= capacity()))
+		{
+			reserve(other.m_size);
+			copy_construct(m_data, other.begin(), other.end());
+			m_size = other.m_size;
+			other.clear();
+			return;
+		}
+
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_capacity = other.m_capacity;
+		other.m_data = NULL;
+		other.m_size = 0;
+		other.m_capacity = 0;
+	}
+
+	size_t grown_capacity(size_t required) const
+	{
+		CompileTimeAssert(growthPercent > 100, "dynamic_array has to grow");
+		return std::max<size_t>(capacity() * growthPercent / 100, required);
+	}
+
+	T* prepare_emplace()
+	{
+		if (m_size == capacity())
+			reserve(grown_capacity(m_size + 1));
+		return m_data + m_size;
+	}
+
+	// moves the elements to a block of newCapacity. Owned trivially relocatable elements are
+	// realloc'ed through the label, others are moved over and destroyed.
+	// Non-owned data is copied and left to its owner.
+	void relocate(size_t newCapacity)
+	{
+		Assert(newCapacity >= m_size);
+
+		if (owns_data())
+		{
+			if (IsTriviallyRelocatable<T>::result)
+			{
+				m_data = reallocate(m_data, newCapacity);
+			}
+			else
+			{
+				T* newData = allocate(newCapacity);
+				for (size_t i = 0; i < m_size; i++)
+					new (newData + i) T(DYNAMIC_ARRAY_MOVE(m_data[i]));
+				destroy(m_data, m_data + m_size);
+				deallocate(m_data);
+				m_data = newData;
+			}
+		}
+		else
+		{
+			T* newData = allocate(newCapacity);
+			copy_construct(newData, m_data, m_data + m_size);
+
+			// Invalidate old non-owned data, since using the data from two places is most likely a really really bad idea.
+#if DEBUGMODE
+			if (IsTriviallyCopyable<T>::result)
+				memset(static_cast<void*>(m_data), 0xCD, capacity() * sizeof(T));
+#endif
+			m_data = newData;
+		}
+
+		m_capacity = newCapacity; // and clear reference bit
+	}
+
+	static void construct_default (T* first, T* last)
+	{
+		// trivially copyable elements are left uninitialized
+		construct_default(first, last, BoolToType<IsTriviallyCopyable<T>::result>());
+	}
+
+	static void construct_default (T*, T*, BoolToType<true>) {}
+
+	static void construct_default (T* first, T* last, BoolToType<false>)
+	{
+		for (; first != last; ++first)
+			new (first) T();
+	}
+
+	static void copy_construct (T* dest, const T* first, const T* last)
+	{
+		copy_construct(dest, first, last, BoolToType<IsTriviallyCopyable<T>::result>());
+	}
+
+	static void copy_construct (T* dest, const T* first, const T* last, BoolToType<true>)
+	{
+		memcpy(dest, first, (last - first) * sizeof(T));
+	}
+
+	static void copy_construct (T* dest, const T* first, const T* last, BoolToType<false>)
+	{
+		std::uninitialized_copy(first, last, dest);
+	}
+
+	// trivially relocatable elements are moved down with memmove, the void* cast is for those that aren't
+	// trivially copyable. Others are move assigned and the ones left over at the end destroyed.
+	static void erase_range (T* first, T* last, T* end, BoolToType<true>)
+	{
+		destroy(first, last);
+		memmove(static_cast<void*>(first), last, (end - last) * sizeof(T));
+	}
+
+	static void erase_range (T* first, T* last, T* end, BoolToType<false>)
+	{
+		size_t leftOverSize = end - last;
+		for (size_t i = 0; i < leftOverSize; i++)
+			first[i] = DYNAMIC_ARRAY_MOVE(last[i]);
+		destroy(first + leftOverSize, end);
+	}
+
+	// fills the elements [index, index + last - first) with the input, moving the elements from index up.
+	// The capacity is already reserved and m_size is still the old size.
+	void insert_range (size_t index, const T* first, const T* last, BoolToType<true>)
+	{
+		// move to the end of where the inserted data will be, then inject the input in the hole
+		memmove(static_cast<void*>(m_data + index + (last - first)), m_data + index, (m_size - index) * sizeof(T));
+		copy_construct(m_data + index, first, last);
+	}
+
+	void insert_range (size_t index, const T* first, const T* last, BoolToType<false>)
+	{
+		size_t count = last - first;
+		// elements landing beyond the old end are constructed, the others are assigned to
+		for (size_t i = m_size; i-- > index;)
+		{
+			if (i + count >= m_size)
+				new (m_data + i + count) T(DYNAMIC_ARRAY_MOVE(m_data[i]));
+			else
+				m_data[i + count] = DYNAMIC_ARRAY_MOVE(m_data[i]);
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			if (index + i >= m_size)
+				new (m_data + index + i) T(first[i]);
+			else
+				m_data[index + i] = first[i];
+		}
+	}
+
+	static void destroy (T* first, T* last)
+	{
+		if (IsTriviallyCopyable<T>::result)
+			return;
+		for (; first != last; ++first)
+			first->~T();
+	}
 
 	T* allocate (size_t size)
 	{
@@ -330,8 +615,8 @@ private:
 		CompileTimeAssert(align != 0, "incomplete type");
 
 		Assert(owns_data());
-		int alignof = static_cast<int>(align);
-		return static_cast<T*> (UNITY_REALLOC_ALIGNED(m_label, data, size * sizeof(T), alignof));
+		int alignment = static_cast<int>(align);
+		return static_cast<T*> (UNITY_REALLOC_ALIGNED(m_label, data, size * sizeof(T), alignment));
 	}
 
 	T*          m_data;
@@ -339,3 +624,10 @@ private:
 	size_t      m_size;
 	size_t      m_capacity;
 };
+
+// found by argument dependent lookup, so generic code swapping two arrays does not copy them
+template <typename T, size_t align, MemLabelIdentifier defaultLabel, size_t growthPercent>
+inline void swap(dynamic_array<T, align, defaultLabel, growthPercent>& lhs, dynamic_array<T, align, defaultLabel, growthPercent>& rhs)
+{
+	lhs.swap(rhs);
+}
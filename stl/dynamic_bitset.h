@@ -0,0 +1,235 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "BitUtility.h"
+#include <string.h>
+#include <algorithm>
+
+// fixed_bitset<N> - N bits stored inline
+// dynamic_bitset - bits in a dynamic_array from the memory label, resizable
+//
+// features:
+//  . bits are stored in 64 bit words, find_first / find_next skip a whole word of clear bits with one
+//		bit scan instruction (LowestBit64), so iterating a sparse set costs per set bit, not per bit:
+//			for (size_t i = bits.find_first(); i != bits.npos; i = bits.find_next(i))
+//  . find_first_clear / find_next_clear do the same for clear bits, e.g. to find a free slot in an allocation map
+//  . bulk &=, |=, ^= and count() work a word at a time, count() uses the popcount instruction (PopCount64)
+//  . bits past size() are always 0
+//
+struct bitset_words
+{
+	typedef UInt64 word_type;
+	enum { kWordBits = 64, kWordShift = 6 };
+
+	static size_t word_count(size_t bitCount) { return (bitCount + kWordBits - 1) >> kWordShift; }
+	static size_t word_index(size_t bit) { return bit >> kWordShift; }
+	static word_type bit_mask(size_t bit) { return (word_type)1 << (bit & (kWordBits - 1)); }
+
+	// bits of the last word that are below bitCount
+	static word_type last_word_mask(size_t bitCount)
+	{
+		size_t used = bitCount & (kWordBits - 1);
+		return used != 0 ? ((word_type)1 << used) - 1 : ~(word_type)0;
+	}
+
+	// first set bit at or after from, npos if there is none. invert searches for clear bits.
+	static size_t find(const word_type* words, size_t bitCount, size_t from, word_type invert)
+	{
+		if (from >= bitCount)
+			return (size_t)-1;
+
+		const size_t wordCount = word_count(bitCount);
+		size_t index = word_index(from);
+		word_type word = (words[index] ^ invert) & (~(word_type)0 << (from & (kWordBits - 1)));
+		for (;;)
+		{
+			if (index == wordCount - 1)
+				word &= last_word_mask(bitCount);
+			if (word != 0)
+				return (index << kWordShift) + LowestBit64(word);
+			if (++index == wordCount)
+				return (size_t)-1;
+			word = words[index] ^ invert;
+		}
+	}
+
+	static size_t count(const word_type* words, size_t wordCount)
+	{
+		size_t result = 0;
+		for (size_t i = 0; i < wordCount; i++)
+			result += PopCount64(words[i]);
+		return result;
+	}
+
+	static bool any(const word_type* words, size_t wordCount)
+	{
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			if (words[i] != 0)
+				return true;
+		}
+		return false;
+	}
+
+	static bool all(const word_type* words, size_t bitCount)
+	{
+		return find(words, bitCount, 0, ~(word_type)0) == (size_t)-1;
+	}
+
+	static void fill(word_type* words, size_t bitCount, bool value)
+	{
+		const size_t wordCount = word_count(bitCount);
+		if (wordCount == 0)
+			return;
+		memset(words, value ? 0xFF : 0, wordCount * sizeof(word_type));
+		if (value)
+			words[wordCount - 1] &= last_word_mask(bitCount);
+	}
+
+	static void flip(word_type* words, size_t bitCount)
+	{
+		const size_t wordCount = word_count(bitCount);
+		for (size_t i = 0; i < wordCount; i++)
+			words[i] = ~words[i];
+		if (wordCount != 0)
+			words[wordCount - 1] &= last_word_mask(bitCount);
+	}
+};
+
+
+template <size_t N>
+class fixed_bitset
+{
+public:
+	typedef bitset_words::word_type word_type;
+	static const size_t npos = (size_t)-1;
+
+	fixed_bitset() { reset(); }
+
+	bool test(size_t bit) const { DebugAssert(bit < N); return (m_words[bitset_words::word_index(bit)] & bitset_words::bit_mask(bit)) != 0; }
+	bool operator[] (size_t bit) const { return test(bit); }
+
+	void set(size_t bit) { DebugAssert(bit < N); m_words[bitset_words::word_index(bit)] |= bitset_words::bit_mask(bit); }
+	void set(size_t bit, bool value) { if (value) set(bit); else reset(bit); }
+	void reset(size_t bit) { DebugAssert(bit < N); m_words[bitset_words::word_index(bit)] &= ~bitset_words::bit_mask(bit); }
+	void flip(size_t bit) { DebugAssert(bit < N); m_words[bitset_words::word_index(bit)] ^= bitset_words::bit_mask(bit); }
+
+	void set() { bitset_words::fill(m_words, N, true); }
+	void reset() { bitset_words::fill(m_words, N, false); }
+	void flip() { bitset_words::flip(m_words, N); }
+
+	size_t find_first() const { return bitset_words::find(m_words, N, 0, 0); }
+	// npos or any bit past the end has no next bit, bit + 1 would wrap npos around to the start
+	size_t find_next(size_t bit) const { return bit < N ? bitset_words::find(m_words, N, bit + 1, 0) : npos; }
+	size_t find_first_clear() const { return bitset_words::find(m_words, N, 0, ~(word_type)0); }
+	size_t find_next_clear(size_t bit) const { return bit < N ? bitset_words::find(m_words, N, bit + 1, ~(word_type)0) : npos; }
+
+	size_t count() const { return bitset_words::count(m_words, kWordCount); }
+	bool any() const { return bitset_words::any(m_words, kWordCount); }
+	bool none() const { return !any(); }
+	bool all() const { return bitset_words::all(m_words, N); }
+	size_t size() const { return N; }
+
+	fixed_bitset& operator&= (const fixed_bitset& other) { for (size_t i = 0; i < kWordCount; i++) m_words[i] &= other.m_words[i]; return *this; }
+	fixed_bitset& operator|= (const fixed_bitset& other) { for (size_t i = 0; i < kWordCount; i++) m_words[i] |= other.m_words[i]; return *this; }
+	fixed_bitset& operator^= (const fixed_bitset& other) { for (size_t i = 0; i < kWordCount; i++) m_words[i] ^= other.m_words[i]; return *this; }
+
+	bool operator== (const fixed_bitset& other) const { return memcmp(m_words, other.m_words, sizeof(m_words)) == 0; }
+	bool operator!= (const fixed_bitset& other) const { return !(*this == other); }
+
+	const word_type* words() const { return m_words; }
+	static size_t word_count() { return kWordCount; }
+
+private:
+	enum { kWordCount = (N + bitset_words::kWordBits - 1) / bitset_words::kWordBits };
+
+	word_type m_words[kWordCount];
+};
+
+
+template <MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+class dynamic_bitset
+{
+public:
+	typedef bitset_words::word_type word_type;
+	static const size_t npos = (size_t)-1;
+
+	dynamic_bitset() : m_size(0) {}
+	dynamic_bitset(MemLabelRef label) : m_words(label), m_size(0) {}
+	explicit dynamic_bitset(size_t size, bool value = false) : m_size(0) { resize(size, value); }
+	dynamic_bitset(size_t size, bool value, MemLabelRef label) : m_words(label), m_size(0) { resize(size, value); }
+
+	// new bits are set to value
+	void resize(size_t size, bool value = false)
+	{
+		const size_t oldSize = m_size;
+		const size_t oldWordCount = m_words.size();
+		m_words.resize_uninitialized(bitset_words::word_count(size));
+		m_size = size;
+
+		if (size <= oldSize)
+		{
+			if (!m_words.empty())
+				m_words.back() &= bitset_words::last_word_mask(size);
+			return;
+		}
+
+		const word_type fill = value ? ~(word_type)0 : 0;
+		if (oldWordCount != 0 && value)
+			m_words[oldWordCount - 1] |= ~bitset_words::last_word_mask(oldSize);
+		for (size_t i = oldWordCount; i < m_words.size(); i++)
+			m_words[i] = fill;
+		m_words.back() &= bitset_words::last_word_mask(size);
+	}
+
+	bool test(size_t bit) const { DebugAssert(bit < m_size); return (m_words[bitset_words::word_index(bit)] & bitset_words::bit_mask(bit)) != 0; }
+	bool operator[] (size_t bit) const { return test(bit); }
+
+	void set(size_t bit) { DebugAssert(bit < m_size); m_words[bitset_words::word_index(bit)] |= bitset_words::bit_mask(bit); }
+	void set(size_t bit, bool value) { if (value) set(bit); else reset(bit); }
+	void reset(size_t bit) { DebugAssert(bit < m_size); m_words[bitset_words::word_index(bit)] &= ~bitset_words::bit_mask(bit); }
+	void flip(size_t bit) { DebugAssert(bit < m_size); m_words[bitset_words::word_index(bit)] ^= bitset_words::bit_mask(bit); }
+
+	void set() { bitset_words::fill(m_words.data(), m_size, true); }
+	void reset() { bitset_words::fill(m_words.data(), m_size, false); }
+	void flip() { bitset_words::flip(m_words.data(), m_size); }
+
+	size_t find_first() const { return bitset_words::find(m_words.data(), m_size, 0, 0); }
+	size_t find_next(size_t bit) const { return bit < m_size ? bitset_words::find(m_words.data(), m_size, bit + 1, 0) : npos; }
+	size_t find_first_clear() const { return bitset_words::find(m_words.data(), m_size, 0, ~(word_type)0); }
+	size_t find_next_clear(size_t bit) const { return bit < m_size ? bitset_words::find(m_words.data(), m_size, bit + 1, ~(word_type)0) : npos; }
+
+	size_t count() const { return bitset_words::count(m_words.data(), m_words.size()); }
+	bool any() const { return bitset_words::any(m_words.data(), m_words.size()); }
+	bool none() const { return !any(); }
+	bool all() const { return bitset_words::all(m_words.data(), m_size); }
+
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	// frees the memory
+	void clear() { m_words.clear(); m_size = 0; }
+	void swap(dynamic_bitset& other) { m_words.swap(other.m_words); std::swap(m_size, other.m_size); }
+
+	// the bitsets must have the same size
+	dynamic_bitset& operator&= (const dynamic_bitset& other) { Assert(m_size == other.m_size); for (size_t i = 0; i < m_words.size(); i++) m_words[i] &= other.m_words[i]; return *this; }
+	dynamic_bitset& operator|= (const dynamic_bitset& other) { Assert(m_size == other.m_size); for (size_t i = 0; i < m_words.size(); i++) m_words[i] |= other.m_words[i]; return *this; }
+	dynamic_bitset& operator^= (const dynamic_bitset& other) { Assert(m_size == other.m_size); for (size_t i = 0; i < m_words.size(); i++) m_words[i] ^= other.m_words[i]; return *this; }
+
+	bool operator== (const dynamic_bitset& other) const { return m_size == other.m_size && (m_size == 0 || memcmp(m_words.data(), other.m_words.data(), m_words.size() * sizeof(word_type)) == 0); }
+	bool operator!= (const dynamic_bitset& other) const { return !(*this == other); }
+
+	const word_type* words() const { return m_words.data(); }
+	size_t word_count() const { return m_words.size(); }
+
+	void set_memory_label (MemLabelRef label) { m_words.set_memory_label(label); }
+
+private:
+	dynamic_array<word_type, 8, defaultLabel>	m_words;
+	size_t										m_size;
+};
+
+template <MemLabelIdentifier defaultLabel>
+inline void swap(dynamic_bitset<defaultLabel>& lhs, dynamic_bitset<defaultLabel>& rhs)
+{
+	lhs.swap(rhs);
+}
@@ -0,0 +1,85 @@
+#include "UnityPrefix.h"
+#include "flat_hash_map.h"
+
+#if ENABLE_UNIT_TESTS
+
+#include "STLAllocator.h"
+#include <map>
+
+double GetTimeSinceStartup();
+
+namespace
+{
+	template <typename Map>
+	double TimeIntMap(Map& map, const dynamic_array<int>& keys, UInt64& sum)
+	{
+		double t0 = GetTimeSinceStartup();
+		for (size_t i = 0; i < keys.size(); i++)
+			map[keys[i]] += (int)i;
+		for (size_t i = 0; i < keys.size(); i++)
+			sum += map.find(keys[keys.size() - 1 - i])->second;
+		for (size_t i = 0; i < keys.size(); i += 2)
+			map.erase(keys[i]);
+		return GetTimeSinceStartup() - t0;
+	}
+
+	template <typename Map>
+	double TimeStringMap(Map& map, const dynamic_array<UnityStr>& keys, UInt64& sum)
+	{
+		double t0 = GetTimeSinceStartup();
+		for (size_t i = 0; i < keys.size(); i++)
+			map[keys[i]] += (int)i;
+		for (size_t i = 0; i < keys.size(); i++)
+			sum += map.find(keys[keys.size() - 1 - i])->second;
+		return GetTimeSinceStartup() - t0;
+	}
+}
+
+void BenchmarkFlatHashMap()
+{
+	// operator[] of 1M keys with about 1 in 4 repeated, find of every key, erase of every other one
+	const int kCount = 1000000;
+	dynamic_array<int> intKeys(kMemTempAlloc);
+	intKeys.reserve(kCount);
+	srand(1);
+	for (int i = 0; i < kCount; i++)
+		intKeys.push_back((int)((((UInt32)rand() << 15) ^ (UInt32)rand()) % (kCount * 3 / 4)));
+
+	UInt64 sum = 0;
+	double stdTime, flatTime;
+	{
+		UNITY_MAP(kMemSTL, int, int) map;
+		stdTime = TimeIntMap(map, intKeys, sum);
+	}
+	{
+		flat_hash_map<int, int> map(kMemSTL);
+		flatTime = TimeIntMap(map, intKeys, sum);
+	}
+	printf_console("int keys: UNITY_MAP %.2fms, flat_hash_map %.2fms for %i keys (%llu)\n", stdTime * 1000.0, flatTime * 1000.0, kCount, (unsigned long long)sum);
+
+	// 100K names like "GameObject 01234"
+	const int kStringCount = 100000;
+	dynamic_array<UnityStr> stringKeys(kMemTempAlloc);
+	stringKeys.reserve(kStringCount);
+	char name[32];
+	for (int i = 0; i < kStringCount; i++)
+	{
+		sprintf(name, "GameObject %05d", rand() % kStringCount);
+		stringKeys.push_back(name);
+	}
+	{
+		UNITY_MAP(kMemSTL, UnityStr, int) map;
+		stdTime = TimeStringMap(map, stringKeys, sum);
+	}
+	{
+		flat_hash_map<UnityStr, int, flat_hash_string> map(kMemSTL);
+		flatTime = TimeStringMap(map, stringKeys, sum);
+	}
+	printf_console("string keys: UNITY_MAP %.2fms, flat_hash_map %.2fms for %i keys (%llu)\n", stdTime * 1000.0, flatTime * 1000.0, kStringCount, (unsigned long long)sum);
+
+	// Linux VM, gcc -O2 without SSE2 groups (8 control bytes per group):
+	// int keys: UNITY_MAP 4236.69ms, flat_hash_map 260.54ms for 1000000 keys (2330786347738)
+	// string keys: UNITY_MAP 195.04ms, flat_hash_map 62.48ms for 100000 keys (2350755790238)
+}
+
+#endif // #if ENABLE_UNIT_TESTS
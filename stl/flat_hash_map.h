@@ -0,0 +1,522 @@
+#pragma once
+
+#include "MemoryMacros.h"
+#include "StaticAssert.h"
+#include "BitUtility.h"
+#include "dynamic_array.h"
+#include <new>
+#include <utility>
+#include <string>
+
+// flat_hash_map / flat_hash_set - open addressing hash tables
+//
+// features:
+//  . elements live in one array from the memory label, there is no allocation per insert and no node to chase
+//  . each slot has a control byte holding 7 bits of the hash. A lookup compares a whole group of control
+//		bytes at once (16 with SSE2, 8 with plain 64 bit arithmetic) and only compares keys whose bits match.
+//  . find, count and erase take any key type that the hash and equal functors accept,
+//		e.g. a const char* for a map with string keys, without constructing a key
+//  . grows X2 when 7/8 of the slots are used, erased slots are reused
+//  . inserting and erasing invalidates iterators and element pointers, keys must not be changed through an iterator
+//  . clear actually deallocates memory
+//
+#ifndef FLAT_HASH_USE_SSE2
+#if UNITY_SUPPORTS_SSE && ((defined _M_X64) || (defined __x86_64__) || (defined _M_IX86_FP && _M_IX86_FP >= 2) || (defined __SSE2__))
+#define FLAT_HASH_USE_SSE2 1
+#else
+#define FLAT_HASH_USE_SSE2 0
+#endif
+#endif
+
+#if FLAT_HASH_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+inline size_t flat_hash_mix (UInt64 value)
+{
+	// the low bits go to the control bytes and the high bits pick the group, both need to depend on all input bits
+	value *= 0x9E3779B97F4A7C15ULL;
+	return (size_t)(value ^ (value >> 32));
+}
+
+template <typename T>
+struct flat_hash
+{
+	size_t operator() (T value) const { return flat_hash_mix((UInt64)value); }
+};
+
+template <typename T>
+struct flat_hash<T*>
+{
+	size_t operator() (const T* value) const { return flat_hash_mix((UInt64)(size_t)value); }
+};
+
+// hashes the characters, so std::string and const char* keys find each other
+struct flat_hash_string
+{
+	size_t operator() (const char* s) const { return hash(s, strlen(s)); }
+
+	template <typename Alloc>
+	size_t operator() (const std::basic_string<char, std::char_traits<char>, Alloc>& s) const { return hash(s.data(), s.size()); }
+
+	static size_t hash (const char* s, size_t length)
+	{
+		// FNV-1a
+		UInt64 value = 14695981039346656037ULL;
+		for (size_t i = 0; i < length; i++)
+			value = (value ^ (UInt8)s[i]) * 1099511628211ULL;
+		return flat_hash_mix(value);
+	}
+};
+
+template <typename Alloc>
+struct flat_hash<std::basic_string<char, std::char_traits<char>, Alloc> > : public flat_hash_string {};
+
+struct flat_equal_to
+{
+	template <typename A, typename B>
+	bool operator() (const A& a, const B& b) const { return a == b; }
+};
+
+// control bytes of kWidth consecutive slots. Full slots hold 7 bits of the hash.
+struct flat_hash_group
+{
+	enum
+	{
+		kEmpty = 0x80,
+		kDeleted = 0xFE,
+#if FLAT_HASH_USE_SSE2
+		kWidth = 16
+#else
+		kWidth = 8
+#endif
+	};
+
+	static bool is_full (UInt8 ctrl) { return ctrl < 0x80; }
+
+#if FLAT_HASH_USE_SSE2
+
+	explicit flat_hash_group (const UInt8* ctrl) : m_ctrl(_mm_load_si128(reinterpret_cast<const __m128i*> (ctrl))) {}
+
+	// bit i is set when slot i matches
+	UInt32 match (UInt8 h2) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)h2), m_ctrl)); }
+	UInt32 match_empty () const { return match(kEmpty); }
+	// kEmpty and kDeleted are the only negative values
+	UInt32 match_empty_or_deleted () const { return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_setzero_si128(), m_ctrl)); }
+
+private:
+	__m128i m_ctrl;
+
+#else
+
+	explicit flat_hash_group (const UInt8* ctrl) { memcpy(&m_ctrl, ctrl, sizeof(m_ctrl)); }
+
+	// bit i is set when slot i matches. match can report a slot above a matching one as well, the keys are compared anyway.
+	UInt32 match (UInt8 h2) const
+	{
+		UInt64 x = m_ctrl ^ (kLsbs * h2);
+		return pack((x - kLsbs) & ~x & kMsbs);
+	}
+	UInt32 match_empty () const { return pack(m_ctrl & (~m_ctrl << 6) & kMsbs); }
+	UInt32 match_empty_or_deleted () const { return pack(m_ctrl & (~m_ctrl << 7) & kMsbs); }
+
+private:
+	static const UInt64 kLsbs = 0x0101010101010101ULL;
+	static const UInt64 kMsbs = 0x8080808080808080ULL;
+
+	// gathers the high bit of each byte into one bit per slot
+	static UInt32 pack (UInt64 msbs)
+	{
+#if UNITY_BIG_ENDIAN
+		return (UInt32)(((msbs >> 7) * 0x8040201008040201ULL) >> 56);
+#else
+		return (UInt32)(((msbs >> 7) * 0x0102040810204080ULL) >> 56);
+#endif
+	}
+
+	UInt64 m_ctrl;
+
+#endif
+};
+
+template <typename V>
+class flat_hash_iterator
+{
+public:
+	flat_hash_iterator() : m_ctrl(NULL), m_end(NULL), m_slot(NULL) {}
+	flat_hash_iterator(const UInt8* ctrl, const UInt8* end, V* slot) : m_ctrl(ctrl), m_end(end), m_slot(slot) { skip_free(); }
+
+	// iterator converts to const_iterator
+	template <typename U>
+	flat_hash_iterator(const flat_hash_iterator<U>& other) : m_ctrl(other.ctrl()), m_end(other.ctrl_end()), m_slot(other.slot()) {}
+
+	V& operator* () const { return *m_slot; }
+	V* operator-> () const { return m_slot; }
+
+	flat_hash_iterator& operator++ ()
+	{
+		++m_ctrl;
+		++m_slot;
+		skip_free();
+		return *this;
+	}
+
+	flat_hash_iterator operator++ (int) { flat_hash_iterator old = *this; ++*this; return old; }
+
+	bool operator== (const flat_hash_iterator& other) const { return m_slot == other.m_slot; }
+	bool operator!= (const flat_hash_iterator& other) const { return m_slot != other.m_slot; }
+
+	const UInt8* ctrl() const { return m_ctrl; }
+	const UInt8* ctrl_end() const { return m_end; }
+	V* slot() const { return m_slot; }
+
+private:
+	void skip_free()
+	{
+		while (m_ctrl != m_end && !flat_hash_group::is_full(*m_ctrl))
+		{
+			++m_ctrl;
+			++m_slot;
+		}
+	}
+
+	const UInt8*	m_ctrl;
+	const UInt8*	m_end;
+	V*				m_slot;
+};
+
+// implementation shared by flat_hash_map and flat_hash_set. KeyOfValue returns the key of a stored value.
+template <typename Value, typename Key, typename KeyOfValue, typename Hash, typename KeyEqual, MemLabelIdentifier defaultLabel>
+class flat_hash_table
+{
+public:
+	typedef Key										key_type;
+	typedef Value									value_type;
+	typedef Hash									hasher;
+	typedef KeyEqual								key_equal;
+	typedef size_t									size_type;
+	typedef flat_hash_iterator<Value>				iterator;
+	typedef flat_hash_iterator<const Value>			const_iterator;
+
+	flat_hash_table() : m_ctrl(NULL), m_slots(NULL), m_capacity(0), m_size(0), m_growthLeft(0), m_label(defaultLabel, NULL)
+	{
+		m_label = MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER());
+	}
+
+	flat_hash_table(MemLabelRef label) : m_ctrl(NULL), m_slots(NULL), m_capacity(0), m_size(0), m_growthLeft(0), m_label(label)
+	{
+	}
+
+	flat_hash_table(const flat_hash_table& other) : m_ctrl(NULL), m_slots(NULL), m_capacity(0), m_size(0), m_growthLeft(0), m_label(other.m_label)
+	{
+		*this = other;
+	}
+
+	~flat_hash_table()
+	{
+		clear();
+	}
+
+	flat_hash_table& operator=(const flat_hash_table& other)
+	{
+		if (&other == this)
+			return *this;
+
+		clear();
+		reserve(other.m_size);
+		for (const_iterator i = other.begin(); i != other.end(); ++i)
+			insert_new(*i);
+		return *this;
+	}
+
+	void swap(flat_hash_table& other) throw()
+	{
+		if (m_ctrl) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(m_ctrl, m_label, other.m_label.GetRootHeader());
+		if (other.m_ctrl) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(other.m_ctrl, other.m_label, m_label.GetRootHeader());
+		std::swap(m_ctrl, other.m_ctrl);
+		std::swap(m_slots, other.m_slots);
+		std::swap(m_capacity, other.m_capacity);
+		std::swap(m_size, other.m_size);
+		std::swap(m_growthLeft, other.m_growthLeft);
+		std::swap(m_label, other.m_label);
+		std::swap(m_hash, other.m_hash);
+		std::swap(m_equal, other.m_equal);
+	}
+
+	// destroys the elements and frees the memory
+	void clear()
+	{
+		for (size_t i = 0; i < m_capacity; i++)
+		{
+			if (flat_hash_group::is_full(m_ctrl[i]))
+				m_slots[i].~Value();
+		}
+		UNITY_FREE(m_label, m_ctrl);
+		m_ctrl = NULL;
+		m_slots = NULL;
+		m_capacity = 0;
+		m_size = 0;
+		m_growthLeft = 0;
+	}
+
+	// makes room for size elements without growing
+	void reserve(size_t size)
+	{
+		size_t capacity = flat_hash_group::kWidth;
+		while (capacity - capacity / 8 < size)
+			capacity *= 2;
+		if (capacity > m_capacity)
+			rehash(capacity);
+	}
+
+	std::pair<iterator, bool> insert(const value_type& value)
+	{
+		size_t hash = m_hash(KeyOfValue()(value));
+		size_t index = find_index(KeyOfValue()(value), hash);
+		if (index != kNotFound)
+			return std::make_pair(make_iterator(index), false);
+
+		index = prepare_insert(hash);
+		new (m_slots + index) Value(value);
+		return std::make_pair(make_iterator(index), true);
+	}
+
+	template <typename K>
+	iterator find(const K& key)
+	{
+		size_t index = find_index(key, m_hash(key));
+		return index != kNotFound ? make_iterator(index) : end();
+	}
+
+	template <typename K>
+	const_iterator find(const K& key) const
+	{
+		return const_cast<flat_hash_table*> (this)->find(key);
+	}
+
+	template <typename K>
+	size_t count(const K& key) const
+	{
+		return find_index(key, m_hash(key)) != kNotFound ? 1 : 0;
+	}
+
+	void erase(iterator position)
+	{
+		erase_index(position.slot() - m_slots);
+	}
+
+	template <typename K>
+	size_t erase(const K& key)
+	{
+		size_t index = find_index(key, m_hash(key));
+		if (index == kNotFound)
+			return 0;
+		erase_index(index);
+		return 1;
+	}
+
+	iterator begin() { return iterator(m_ctrl, m_ctrl + m_capacity, m_slots); }
+	iterator end() { return iterator(m_ctrl + m_capacity, m_ctrl + m_capacity, m_slots + m_capacity); }
+	const_iterator begin() const { return const_cast<flat_hash_table*> (this)->begin(); }
+	const_iterator end() const { return const_cast<flat_hash_table*> (this)->end(); }
+
+	bool empty () const { return m_size == 0; }
+	size_t size() const { return m_size; }
+	// number of slots
+	size_t capacity() const { return m_capacity; }
+
+	void set_memory_label (MemLabelRef label)
+	{
+		Assert(m_ctrl == NULL);
+		m_label = label;
+	}
+
+protected:
+
+	static const size_t kNotFound = ~(size_t)0;
+
+	iterator make_iterator(size_t index) { return iterator(m_ctrl + index, m_ctrl + m_capacity, m_slots + index); }
+
+	// inserts a value that is known not to be in the table
+	Value& insert_new(const value_type& value)
+	{
+		return insert_new(value, m_hash(KeyOfValue()(value)));
+	}
+
+	// same with the hash of its key, for callers that already looked the key up
+	Value& insert_new(const value_type& value, size_t hash)
+	{
+		size_t index = prepare_insert(hash);
+		return *new (m_slots + index) Value(value);
+	}
+
+	// groups are probed quadratically, the group count is a power of two so every group is visited
+	template <typename K>
+	size_t find_index(const K& key, size_t hash) const
+	{
+		if (m_capacity == 0)
+			return kNotFound;
+
+		const size_t groupMask = m_capacity / flat_hash_group::kWidth - 1;
+		size_t group = (hash >> 7) & groupMask;
+		for (size_t step = 1; ; step++)
+		{
+			size_t first = group * flat_hash_group::kWidth;
+			flat_hash_group ctrl(m_ctrl + first);
+			for (UInt32 bits = ctrl.match(hash & 0x7F); bits != 0; bits &= bits - 1)
+			{
+				size_t index = first + LowestBit(bits);
+				if (m_equal(KeyOfValue()(m_slots[index]), key))
+					return index;
+			}
+
+			// a group with an empty slot ends every probe sequence that reached it
+			if (ctrl.match_empty() != 0)
+				return kNotFound;
+			group = (group + step) & groupMask;
+		}
+	}
+
+	size_t find_free(size_t hash) const
+	{
+		const size_t groupMask = m_capacity / flat_hash_group::kWidth - 1;
+		size_t group = (hash >> 7) & groupMask;
+		for (size_t step = 1; ; step++)
+		{
+			size_t first = group * flat_hash_group::kWidth;
+			UInt32 bits = flat_hash_group(m_ctrl + first).match_empty_or_deleted();
+			if (bits != 0)
+				return first + LowestBit(bits);
+			group = (group + step) & groupMask;
+		}
+	}
+
+	// claims a slot for a new element of hash, the caller constructs the element
+	size_t prepare_insert(size_t hash)
+	{
+		if (m_capacity == 0)
+			rehash(flat_hash_group::kWidth);
+
+		size_t index = find_free(hash);
+		if (m_growthLeft == 0 && m_ctrl[index] != flat_hash_group::kDeleted)
+		{
+			// mostly erased slots are cleaned up without growing
+			rehash(m_size * 16 < m_capacity * 7 ? m_capacity : m_capacity * 2);
+			index = find_free(hash);
+		}
+
+		if (m_ctrl[index] == flat_hash_group::kEmpty)
+			m_growthLeft--;
+		m_ctrl[index] = (UInt8)(hash & 0x7F);
+		m_size++;
+		return index;
+	}
+
+	void erase_index(size_t index)
+	{
+		Assert(index < m_capacity && flat_hash_group::is_full(m_ctrl[index]));
+		m_slots[index].~Value();
+		m_size--;
+
+		// probes stop at the group anyway when it has an empty slot, otherwise the slot has to stay a tombstone
+		if (flat_hash_group(m_ctrl + index / flat_hash_group::kWidth * flat_hash_group::kWidth).match_empty() != 0)
+		{
+			m_ctrl[index] = flat_hash_group::kEmpty;
+			m_growthLeft++;
+		}
+		else
+			m_ctrl[index] = flat_hash_group::kDeleted;
+	}
+
+	void rehash(size_t capacity)
+	{
+		Assert(IsPowerOfTwo(capacity) && capacity >= flat_hash_group::kWidth);
+
+		UInt8* oldCtrl = m_ctrl;
+		Value* oldSlots = m_slots;
+		size_t oldCapacity = m_capacity;
+
+		// control bytes first, the slots follow aligned
+		const size_t alignment = std::max<size_t>(16, ALIGN_OF(Value));
+		size_t ctrlSize = (capacity + alignment - 1) & ~(alignment - 1);
+		m_ctrl = static_cast<UInt8*> (UNITY_MALLOC_ALIGNED(m_label, ctrlSize + capacity * sizeof(Value), alignment));
+		m_slots = reinterpret_cast<Value*> (m_ctrl + ctrlSize);
+		m_capacity = capacity;
+		m_growthLeft = capacity - capacity / 8;
+		memset(m_ctrl, flat_hash_group::kEmpty, capacity);
+
+		for (size_t i = 0; i < oldCapacity; i++)
+		{
+			if (!flat_hash_group::is_full(oldCtrl[i]))
+				continue;
+
+			size_t hash = m_hash(KeyOfValue()(oldSlots[i]));
+			size_t index = find_free(hash);
+			m_ctrl[index] = (UInt8)(hash & 0x7F);
+			m_growthLeft--;
+			new (m_slots + index) Value(DYNAMIC_ARRAY_MOVE(oldSlots[i]));
+			oldSlots[i].~Value();
+		}
+
+		UNITY_FREE(m_label, oldCtrl);
+	}
+
+	UInt8*		m_ctrl; // start of the allocation
+	Value*		m_slots;
+	size_t		m_capacity;
+	size_t		m_size;
+	size_t		m_growthLeft; // empty slots that can be used before growing
+	MemLabelId	m_label;
+	Hash		m_hash;
+	KeyEqual	m_equal;
+};
+
+template <typename Value, typename Key, typename KeyOfValue, typename Hash, typename KeyEqual, MemLabelIdentifier defaultLabel>
+inline void swap(flat_hash_table<Value, Key, KeyOfValue, Hash, KeyEqual, defaultLabel>& lhs, flat_hash_table<Value, Key, KeyOfValue, Hash, KeyEqual, defaultLabel>& rhs)
+{
+	lhs.swap(rhs);
+}
+
+template <typename Key>
+struct flat_hash_set_key
+{
+	const Key& operator() (const Key& value) const { return value; }
+};
+
+template <typename Key, typename T>
+struct flat_hash_map_key
+{
+	const Key& operator() (const std::pair<const Key, T>& value) const { return value.first; }
+};
+
+template <typename Key, typename T, typename Hash = flat_hash<Key>, typename KeyEqual = flat_equal_to, MemLabelIdentifier defaultLabel = kMemSTLId>
+class flat_hash_map : public flat_hash_table<std::pair<const Key, T>, Key, flat_hash_map_key<Key, T>, Hash, KeyEqual, defaultLabel>
+{
+	typedef flat_hash_table<std::pair<const Key, T>, Key, flat_hash_map_key<Key, T>, Hash, KeyEqual, defaultLabel> base_type;
+
+public:
+	typedef T mapped_type;
+
+	flat_hash_map() {}
+	flat_hash_map(MemLabelRef label) : base_type(label) {}
+
+	T& operator[] (const Key& key)
+	{
+		// hashed once for the lookup and the insert
+		size_t hash = this->m_hash(key);
+		size_t index = this->find_index(key, hash);
+		if (index != base_type::kNotFound)
+			return this->m_slots[index].second;
+		return this->insert_new(typename base_type::value_type(key, T()), hash).second;
+	}
+};
+
+template <typename Key, typename Hash = flat_hash<Key>, typename KeyEqual = flat_equal_to, MemLabelIdentifier defaultLabel = kMemSTLId>
+class flat_hash_set : public flat_hash_table<Key, Key, flat_hash_set_key<Key>, Hash, KeyEqual, defaultLabel>
+{
+	typedef flat_hash_table<Key, Key, flat_hash_set_key<Key>, Hash, KeyEqual, defaultLabel> base_type;
+
+public:
+	flat_hash_set() {}
+	flat_hash_set(MemLabelRef label) : base_type(label) {}
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "BitUtility.h"
+#include <algorithm>
+
+// ring_buffer - fixed capacity FIFO, not thread safe. See concurrent_queue.h for queues shared between threads.
+//
+// features:
+//  . one allocation from the memory label when constructed, push_back and pop_front never allocate
+//  . the capacity is rounded up to a power of two
+//  . push_back returns false when the buffer is full, pop_front(T&) returns false when it is empty
+//  . batch push_back / pop_front of count elements
+//  . operator[] indexes from the oldest element
+//  . elements that are not trivially copyable are copy constructed and destroyed like in dynamic_array
+//
+template <typename T, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+class ring_buffer
+{
+public:
+	typedef T		value_type;
+	typedef size_t	size_type;
+
+	explicit ring_buffer(size_t capacity) : m_data(NULL), m_mask(0), m_read(0), m_write(0), m_label(defaultLabel, NULL)
+	{
+		m_label = MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER());
+		allocate(capacity);
+	}
+
+	ring_buffer(size_t capacity, MemLabelRef label) : m_data(NULL), m_mask(0), m_read(0), m_write(0), m_label(label)
+	{
+		allocate(capacity);
+	}
+
+	~ring_buffer()
+	{
+		clear();
+		UNITY_FREE(m_label, m_data);
+	}
+
+	// returns false if the buffer is full
+	bool push_back(const T& value)
+	{
+		if (full())
+			return false;
+		new (&m_data[m_write & m_mask]) T(value);
+		m_write++;
+		return true;
+	}
+
+	// pushes as many of the values as fit, returns how many were pushed
+	size_t push_back(const T* values, size_t count)
+	{
+		count = std::min(count, capacity() - size());
+		for (size_t i = 0; i < count; i++)
+			new (&m_data[(m_write + i) & m_mask]) T(values[i]);
+		m_write += (UInt32)count;
+		return count;
+	}
+
+	// returns false if the buffer is empty
+	bool pop_front(T& value)
+	{
+		if (empty())
+			return false;
+		value = m_data[m_read & m_mask];
+		pop_front();
+		return true;
+	}
+
+	// pops up to count values into values, returns how many were popped
+	size_t pop_front(T* values, size_t count)
+	{
+		count = std::min(count, size());
+		for (size_t i = 0; i < count; i++)
+		{
+			T& element = m_data[(m_read + i) & m_mask];
+			values[i] = element;
+			element.~T();
+		}
+		m_read += (UInt32)count;
+		return count;
+	}
+
+	void pop_front()
+	{
+		DebugAssert(!empty());
+		m_data[m_read & m_mask].~T();
+		m_read++;
+	}
+
+	void clear()
+	{
+		while (!empty())
+			pop_front();
+	}
+
+	T& front() { DebugAssert(!empty()); return m_data[m_read & m_mask]; }
+	const T& front() const { DebugAssert(!empty()); return m_data[m_read & m_mask]; }
+	T& back() { DebugAssert(!empty()); return m_data[(m_write - 1) & m_mask]; }
+	const T& back() const { DebugAssert(!empty()); return m_data[(m_write - 1) & m_mask]; }
+
+	T& operator[] (size_t index) { DebugAssert(index < size()); return m_data[(m_read + index) & m_mask]; }
+	const T& operator[] (size_t index) const { DebugAssert(index < size()); return m_data[(m_read + index) & m_mask]; }
+
+	// the positions are free running counters, the difference is right also after they wrap around
+	size_t size() const { return m_write - m_read; }
+	size_t capacity() const { return m_mask + 1; }
+	bool empty() const { return m_write == m_read; }
+	bool full() const { return size() == capacity(); }
+
+private:
+	// Non copyable
+	ring_buffer(const ring_buffer&);
+	ring_buffer& operator=(const ring_buffer&);
+
+	void allocate(size_t capacity)
+	{
+		Assert(capacity > 0 && capacity <= (1U << 31));
+		m_mask = NextPowerOfTwo((UInt32)capacity) - 1;
+		m_data = static_cast<T*> (UNITY_MALLOC_ALIGNED(m_label, (m_mask + 1) * sizeof(T), AlignOfType<T>::align));
+	}
+
+	T*			m_data;
+	UInt32		m_mask;
+	UInt32		m_read;
+	UInt32		m_write;
+	MemLabelId	m_label;
+};
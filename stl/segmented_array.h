@@ -0,0 +1,276 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "BitUtility.h"
+
+// segmented_array - array with stable element addresses
+//
+// features:
+//  . elements are stored in blocks that never move, pointers to elements stay valid until the element is removed
+//  . block k holds (1 << firstBlockShift) << k elements, so growing allocates one block and copies nothing.
+//		Peak memory and push_back latency don't spike like they do when dynamic_array reallocates.
+//  . operator[] is O(1), the block is found with HighestBit
+//  . iterate with begin()/end(), or per block with block_count()/block_data()/block_size() for tight loops
+//  . clear actually deallocates memory, pop_back and resize keep the blocks
+//  . push_back(void) default initializes, POD members are NOT initialized!
+//
+template <typename T, int firstBlockShift = 4, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+struct segmented_array
+{
+public:
+	typedef 	T									value_type;
+	typedef 	size_t								size_type;
+	typedef 	T&									reference;
+	typedef 	const T&							const_reference;
+
+	enum
+	{
+		kFirstBlockSize = 1 << firstBlockShift,
+		kMaxBlockCount = 32 // the block index is computed from 32 bits
+	};
+
+	template <typename Array, typename Value>
+	class iterator_base
+	{
+	public:
+		iterator_base() : m_array(NULL), m_index(0), m_ptr(NULL), m_blockEnd(NULL) {}
+		iterator_base(Array* array, size_t index) : m_array(array), m_index(index), m_ptr(NULL), m_blockEnd(NULL)
+		{
+			if (index < array->size())
+				seek();
+		}
+
+		Value& operator* () const { return *m_ptr; }
+		Value* operator-> () const { return m_ptr; }
+
+		iterator_base& operator++ ()
+		{
+			++m_index;
+			if (++m_ptr == m_blockEnd && m_index < m_array->size())
+				seek();
+			return *this;
+		}
+
+		iterator_base operator++ (int) { iterator_base old = *this; ++*this; return old; }
+
+		bool operator== (const iterator_base& other) const { return m_index == other.m_index; }
+		bool operator!= (const iterator_base& other) const { return m_index != other.m_index; }
+
+		size_t index() const { return m_index; }
+
+	private:
+		void seek()
+		{
+			int block;
+			size_t offset;
+			locate(m_index, block, offset);
+			m_ptr = m_array->m_blocks[block] + offset;
+			m_blockEnd = m_ptr - offset + ((size_t)kFirstBlockSize << block);
+		}
+
+		Array*	m_array;
+		size_t	m_index;
+		Value*	m_ptr;
+		Value*	m_blockEnd;
+	};
+
+	typedef iterator_base<segmented_array, T>				iterator;
+	typedef iterator_base<const segmented_array, const T>	const_iterator;
+
+	segmented_array() : m_size(0), m_blockCount(0), m_label(defaultLabel, NULL)
+	{
+		m_label = MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER());
+	}
+
+	segmented_array(MemLabelRef label) : m_size(0), m_blockCount(0), m_label(label)
+	{
+	}
+
+	segmented_array(const segmented_array& other) : m_size(0), m_blockCount(0), m_label(other.m_label)
+	{
+		*this = other;
+	}
+
+	~segmented_array()
+	{
+		clear();
+	}
+
+	segmented_array& operator=(const segmented_array& other)
+	{
+		if (&other == this)
+			return *this;
+
+		resize(0);
+		reserve(other.m_size);
+		for (const_iterator i = other.begin(); i != other.end(); ++i)
+			push_back(*i);
+		return *this;
+	}
+
+	void swap(segmented_array& other) throw()
+	{
+		for (int i = 0; i < std::max(m_blockCount, other.m_blockCount); i++)
+		{
+			if (i < m_blockCount) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(m_blocks[i], m_label, other.m_label.GetRootHeader());
+			if (i < other.m_blockCount) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(other.m_blocks[i], other.m_label, m_label.GetRootHeader());
+			std::swap(m_blocks[i], other.m_blocks[i]);
+		}
+		std::swap(m_size, other.m_size);
+		std::swap(m_blockCount, other.m_blockCount);
+		std::swap(m_label, other.m_label);
+	}
+
+	// frees all blocks, use resize(0) to clear w/o freeing
+	void clear()
+	{
+		resize(0);
+		shrink_to_fit();
+	}
+
+	T& push_back()
+	{
+		return *new (prepare_push_back()) T;
+	}
+
+	void push_back(const T& t)
+	{
+		new (prepare_push_back()) T(t);
+	}
+
+	// constructs the element in place
+	template<class A1>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1))
+	{
+		return *new (prepare_push_back()) T(DYNAMIC_ARRAY_FORWARD(A1, a1));
+	}
+
+	template<class A1, class A2>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1), DYNAMIC_ARRAY_ARG(A2, a2))
+	{
+		return *new (prepare_push_back()) T(DYNAMIC_ARRAY_FORWARD(A1, a1), DYNAMIC_ARRAY_FORWARD(A2, a2));
+	}
+
+	template<class A1, class A2, class A3>
+	T& emplace_back(DYNAMIC_ARRAY_ARG(A1, a1), DYNAMIC_ARRAY_ARG(A2, a2), DYNAMIC_ARRAY_ARG(A3, a3))
+	{
+		return *new (prepare_push_back()) T(DYNAMIC_ARRAY_FORWARD(A1, a1), DYNAMIC_ARRAY_FORWARD(A2, a2), DYNAMIC_ARRAY_FORWARD(A3, a3));
+	}
+
+	void pop_back()
+	{
+		Assert(m_size >= 1);
+		back().~T();
+		m_size--;
+	}
+
+	// destroys the elements from size on, or default initializes up to size
+	void resize(size_t size)
+	{
+		while (m_size > size)
+			pop_back();
+		reserve(size);
+		while (m_size < size)
+			push_back();
+	}
+
+	// allocates blocks until capacity() >= inCapacity
+	void reserve(size_t inCapacity)
+	{
+		while (capacity() < inCapacity)
+			add_block();
+	}
+
+	// frees the blocks that hold no elements
+	void shrink_to_fit()
+	{
+		while (m_blockCount > 0 && block_start(m_blockCount - 1) >= m_size)
+		{
+			m_blockCount--;
+			UNITY_FREE(m_label, m_blocks[m_blockCount]);
+		}
+	}
+
+	T& operator[] (size_t index) { DebugAssert(index < m_size); return *element(index); }
+	T const& operator[] (size_t index) const { DebugAssert(index < m_size); return *element(index); }
+
+	T& back() { Assert (m_size != 0); return *element(m_size - 1); }
+	T const& back() const { Assert (m_size != 0); return *element(m_size - 1); }
+	T& front() { Assert (m_size != 0); return m_blocks[0][0]; }
+	T const& front() const { Assert (m_size != 0); return m_blocks[0][0]; }
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, m_size); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, m_size); }
+
+	bool empty () const { return m_size == 0; }
+	size_t size() const { return m_size; }
+	size_t capacity() const { return block_start(m_blockCount); }
+
+	// blocks that hold elements, block_size is the used part of a block. The elements of a block are contiguous
+	int block_count() const { return m_size == 0 ? 0 : block_of(m_size - 1) + 1; }
+	T* block_data(int block) { return m_blocks[block]; }
+	T const* block_data(int block) const { return m_blocks[block]; }
+	size_t block_size(int block) const { return std::min(m_size - block_start(block), (size_t)kFirstBlockSize << block); }
+
+	void set_memory_label (MemLabelRef label)
+	{
+		Assert(m_blockCount == 0);
+		m_label = label;
+	}
+
+private:
+
+	// block k starts at index kFirstBlockSize * ((1 << k) - 1), adding kFirstBlockSize makes that a power of two
+	static void locate (size_t index, int& block, size_t& offset)
+	{
+		size_t biased = index + kFirstBlockSize;
+		block = HighestBit((UInt32)(biased >> firstBlockShift));
+		offset = biased - ((size_t)kFirstBlockSize << block);
+	}
+
+	static int block_of (size_t index)
+	{
+		return HighestBit((UInt32)((index + kFirstBlockSize) >> firstBlockShift));
+	}
+
+	static size_t block_start (int block)
+	{
+		return ((size_t)kFirstBlockSize << block) - kFirstBlockSize;
+	}
+
+	T* element (size_t index) const
+	{
+		int block;
+		size_t offset;
+		locate(index, block, offset);
+		return m_blocks[block] + offset;
+	}
+
+	T* prepare_push_back()
+	{
+		if (m_size == capacity())
+			add_block();
+		return element(m_size++);
+	}
+
+	void add_block()
+	{
+		Assert(m_blockCount < kMaxBlockCount);
+		size_t size = ((size_t)kFirstBlockSize << m_blockCount) * sizeof(T);
+		m_blocks[m_blockCount] = static_cast<T*> (UNITY_MALLOC_ALIGNED(m_label, size, ALIGN_OF(T)));
+		m_blockCount++;
+	}
+
+	T*			m_blocks[kMaxBlockCount];
+	size_t		m_size;
+	int			m_blockCount;
+	MemLabelId	m_label;
+};
+
+template <typename T, int firstBlockShift, MemLabelIdentifier defaultLabel>
+inline void swap(segmented_array<T, firstBlockShift, defaultLabel>& lhs, segmented_array<T, firstBlockShift, defaultLabel>& rhs)
+{
+	lhs.swap(rhs);
+}
@@ -0,0 +1,70 @@
+#include "UnityPrefix.h"
+#include "slot_map.h"
+
+#if ENABLE_UNIT_TESTS
+
+#include <vector>
+
+void TestSlotMap()
+{
+	// random inserts and erases, live handles find their object and erased ones nothing
+	slot_map<int> map(kMemTempAlloc);
+	std::vector<slot_map_handle> live, dead;
+	std::vector<int> values;
+	srand(1);
+	for (int i = 0; i < 50000; i++)
+	{
+		if (live.empty() || rand() % 3 != 0)
+		{
+			live.push_back(map.insert(i));
+			values.push_back(i);
+		}
+		else
+		{
+			size_t erased = rand() % live.size();
+			AssertMsg(map.erase(live[erased]) && !map.erase(live[erased]), "erase of handle %x", live[erased].value);
+			dead.push_back(live[erased]);
+			live[erased] = live.back();
+			live.pop_back();
+			values[erased] = values.back();
+			values.pop_back();
+		}
+	}
+	AssertMsg(map.size() == live.size(), "slot_map size");
+	for (size_t i = 0; i < live.size(); i++)
+		AssertMsg(map.get(live[i]) != NULL && *map.get(live[i]) == values[i], "live handle %x", live[i].value);
+	for (size_t i = 0; i < dead.size(); i++)
+		AssertMsg(!map.contains(dead[i]), "stale handle %x", dead[i].value);
+	for (slot_map<int>::iterator i = map.begin(); i != map.end(); ++i)
+		AssertMsg(map.get(map.get_handle(i)) == i, "get_handle");
+	AssertMsg(!map.contains(slot_map_handle()), "null handle");
+	map.clear();
+	AssertMsg(map.empty(), "clear");
+
+	// a single slot reused past its last generation wraps around instead of growing the map
+	slot_map<int> reused(kMemTempAlloc);
+	slot_map_handle first = reused.insert(0);
+	slot_map_handle handle = first;
+	for (int i = 1; i <= slot_map_handle::kMaxGeneration; i++)
+	{
+		reused.erase(handle);
+		handle = reused.insert(i);
+		AssertMsg(handle.index() == first.index() && !handle.is_null(), "slot reuse %d", i);
+	}
+	AssertMsg(handle.generation() == 1 && handle == first && reused[handle] == slot_map_handle::kMaxGeneration, "generation wraps around");
+
+	// insert fails with a null handle once every index is in use, and works again after an erase
+	slot_map<int> full(kMemTempAlloc);
+	full.reserve(slot_map_handle::kMaxIndex + 1);
+	for (int i = 0; i <= slot_map_handle::kMaxIndex; i++)
+		full.insert(i);
+	slot_map_handle failed = full.insert(-1);
+	AssertMsg(failed.is_null() && full.size() == slot_map_handle::kMaxIndex + 1, "insert into a full slot_map");
+	AssertMsg(!full.contains(failed), "failed insert gives no object");
+	slot_map_handle last = full.get_handle(full.end() - 1);
+	AssertMsg(full.erase(last), "erase from a full slot_map");
+	slot_map_handle again = full.insert(-1);
+	AssertMsg(!again.is_null() && again.index() == last.index() && full[again] == -1 && !full.contains(last), "insert after erase");
+}
+
+#endif // #if ENABLE_UNIT_TESTS
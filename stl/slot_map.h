@@ -0,0 +1,196 @@
+#pragma once
+
+#include "dynamic_array.h"
+
+// slot_map - objects referenced by 32 bit handles instead of pointers
+//
+// features:
+//  . insert returns a handle holding a slot index and the generation of the slot
+//  . erasing bumps the generation, so stale handles are detected: get() returns NULL for them
+//  . insert, erase and get are O(1)
+//  . the objects are stored densely in a dynamic_array from the memory label, begin()/end() iterate
+//		the live objects only. Erase moves the last object into the hole, pointers to objects are not stable, handles are.
+//  . released slots are reused oldest first. The generation of a slot wraps around after kMaxGeneration reuses,
+//		only a handle kept across all of them is mistaken for the new object.
+//  . at most kMaxIndex + 1 objects, insert returns a null handle when all slots are in use
+//
+struct slot_map_handle
+{
+	enum
+	{
+		kIndexBits = 20,
+		kGenerationBits = 32 - kIndexBits,
+		kMaxIndex = (1 << kIndexBits) - 1,
+		kMaxGeneration = (1 << kGenerationBits) - 1
+	};
+
+	slot_map_handle() : value(0) {}
+	slot_map_handle(UInt32 index, UInt32 generation) : value(index | (generation << kIndexBits)) {}
+
+	UInt32 index() const { return value & kMaxIndex; }
+	// generations start at 1, a default constructed handle is never valid
+	UInt32 generation() const { return value >> kIndexBits; }
+	bool is_null() const { return value == 0; }
+
+	bool operator== (const slot_map_handle& other) const { return value == other.value; }
+	bool operator!= (const slot_map_handle& other) const { return value != other.value; }
+
+	UInt32 value;
+};
+
+template <typename T, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+class slot_map
+{
+public:
+	typedef T							value_type;
+	typedef slot_map_handle				handle;
+	typedef T*							iterator;
+	typedef const T*					const_iterator;
+
+	slot_map() : m_freeHead(kNoSlot), m_freeTail(kNoSlot) {}
+	slot_map(MemLabelRef label) : m_objects(label), m_objectSlots(label), m_slots(label), m_freeHead(kNoSlot), m_freeTail(kNoSlot) {}
+
+	// null handle when all slots are in use
+	handle insert(const T& value)
+	{
+		handle h = allocate_slot();
+		if (!h.is_null())
+			m_objects.push_back(value);
+		return h;
+	}
+
+	// inserts a default constructed object
+	handle insert()
+	{
+		handle h = allocate_slot();
+		if (!h.is_null())
+			m_objects.emplace_back();
+		return h;
+	}
+
+	// returns false if the handle is stale
+	bool erase(handle h)
+	{
+		if (get(h) == NULL)
+			return false;
+
+		Slot& slot = m_slots[h.index()];
+		UInt32 objectIndex = slot.object;
+		UInt32 last = (UInt32)m_objects.size() - 1;
+		if (objectIndex != last)
+		{
+			m_objects[objectIndex] = DYNAMIC_ARRAY_MOVE(m_objects[last]);
+			m_objectSlots[objectIndex] = m_objectSlots[last];
+			m_slots[m_objectSlots[objectIndex]].object = objectIndex;
+		}
+		m_objects.pop_back();
+		m_objectSlots.pop_back();
+
+		release_slot(h.index());
+		return true;
+	}
+
+	// NULL if the handle is stale
+	T* get(handle h)
+	{
+		UInt32 index = h.index();
+		if (index >= m_slots.size() || m_slots[index].generation != h.generation() || m_slots[index].object == kNoSlot)
+			return NULL;
+		return &m_objects[m_slots[index].object];
+	}
+
+	const T* get(handle h) const { return const_cast<slot_map*> (this)->get(h); }
+
+	bool contains(handle h) const { return get(h) != NULL; }
+
+	T& operator[] (handle h) { T* value = get(h); Assert(value != NULL); return *value; }
+	const T& operator[] (handle h) const { const T* value = get(h); Assert(value != NULL); return *value; }
+
+	// handle of the object at it, for iteration
+	handle get_handle(const_iterator it) const
+	{
+		UInt32 index = m_objectSlots[it - m_objects.begin()];
+		return handle(index, m_slots[index].generation);
+	}
+
+	// erases all objects, handles given out so far stay invalid
+	void clear()
+	{
+		while (!m_objects.empty())
+			erase(get_handle(m_objects.end() - 1));
+	}
+
+	void reserve(size_t size)
+	{
+		m_objects.reserve(size);
+		m_objectSlots.reserve(size);
+		m_slots.reserve(size);
+	}
+
+	iterator begin() { return m_objects.begin(); }
+	iterator end() { return m_objects.end(); }
+	const_iterator begin() const { return m_objects.begin(); }
+	const_iterator end() const { return m_objects.end(); }
+
+	bool empty () const { return m_objects.empty(); }
+	size_t size() const { return m_objects.size(); }
+
+private:
+
+	enum { kNoSlot = 0xFFFFFFFF };
+
+	struct Slot
+	{
+		UInt32 generation;
+		UInt32 object; // index into m_objects, kNoSlot while free
+		UInt32 nextFree;
+	};
+
+	handle allocate_slot()
+	{
+		UInt32 index;
+		if (m_freeHead != kNoSlot)
+		{
+			index = m_freeHead;
+			m_freeHead = m_slots[index].nextFree;
+			if (m_freeHead == kNoSlot)
+				m_freeTail = kNoSlot;
+		}
+		else
+		{
+			// the handle has no room for more slots
+			if (m_slots.size() > slot_map_handle::kMaxIndex)
+				return handle();
+			index = (UInt32)m_slots.size();
+			m_slots.push_back().generation = 1;
+		}
+
+		Slot& slot = m_slots[index];
+		slot.object = (UInt32)m_objects.size();
+		slot.nextFree = kNoSlot;
+		m_objectSlots.push_back(index);
+		return handle(index, slot.generation);
+	}
+
+	void release_slot(UInt32 index)
+	{
+		Slot& slot = m_slots[index];
+		slot.object = kNoSlot;
+		// generation 0 is left out, so index 0 never makes a null handle
+		slot.generation = slot.generation == slot_map_handle::kMaxGeneration ? 1 : slot.generation + 1;
+
+		// reusing the oldest free slot first spreads the generations over all slots, so they wrap around late
+		slot.nextFree = kNoSlot;
+		if (m_freeTail != kNoSlot)
+			m_slots[m_freeTail].nextFree = index;
+		else
+			m_freeHead = index;
+		m_freeTail = index;
+	}
+
+	dynamic_array<T, AlignOfType<T>::align, defaultLabel>	m_objects;
+	dynamic_array<UInt32, 4, defaultLabel>					m_objectSlots; // slot of each object
+	dynamic_array<Slot, 4, defaultLabel>					m_slots;
+	UInt32													m_freeHead;
+	UInt32													m_freeTail;
+};
@@ -0,0 +1,89 @@
+#include "UnityPrefix.h"
+#include "small_dynamic_array.h"
+
+#if ENABLE_UNIT_TESTS
+
+namespace
+{
+	template <typename Array>
+	bool HasElements(const Array& array, int first, int count)
+	{
+		if (array.size() != (size_t)count)
+			return false;
+		for (int i = 0; i < count; i++)
+			if (array[i] != first + i)
+				return false;
+		return true;
+	}
+
+	template <typename Array>
+	void PushElements(Array& array, int first, int count)
+	{
+		for (int i = 0; i < count; i++)
+			array.push_back(first + i);
+	}
+}
+
+void TestSmallDynamicArray()
+{
+	typedef small_dynamic_array<int, 8> SmallArray;
+
+	SmallArray a (kMemTempAlloc);
+	PushElements(a, 0, 8);
+	AssertMsg(a.uses_inline_storage() && HasElements(a, 0, 8), "8 elements stay inline");
+	a.push_back(8);
+	AssertMsg(!a.uses_inline_storage() && HasElements(a, 0, 9), "spill to the heap");
+	a.resize_uninitialized(4);
+	a.shrink_to_fit();
+	AssertMsg(a.uses_inline_storage() && HasElements(a, 0, 4), "shrink_to_fit goes back inline");
+
+	SmallArray b (a);
+	PushElements(b, 4, 20);
+	a.swap(b);
+	AssertMsg(HasElements(a, 0, 24) && !a.uses_inline_storage() && HasElements(b, 0, 4) && b.uses_inline_storage(), "swap heap and inline");
+	swap(a, b);
+	AssertMsg(HasElements(b, 0, 24) && HasElements(a, 0, 4) && a.uses_inline_storage(), "swap found by argument dependent lookup");
+
+	// through a dynamic_array& the inline storage is never freed or handed to another array
+	dynamic_array<int>& base = a;
+	base.clear();
+	AssertMsg(a.uses_inline_storage() && a.empty(), "clear through dynamic_array& keeps the inline storage");
+	PushElements(base, 0, 3);
+	PushElements(base, 3, 20);
+	AssertMsg(HasElements(a, 0, 23) && !a.uses_inline_storage(), "grow after clear through dynamic_array&");
+	a.clear();
+
+	SmallArray c (kMemTempAlloc), d (kMemTempAlloc);
+	PushElements(c, 0, 3);
+	PushElements(d, 10, 5);
+	dynamic_array<int>& baseC = c;
+	dynamic_array<int>& baseD = d;
+	baseC.swap(baseD);
+	AssertMsg(HasElements(c, 10, 5) && HasElements(d, 0, 3), "swap of two inline arrays through dynamic_array&");
+	swap(baseC, baseD);
+	AssertMsg(HasElements(c, 0, 3) && HasElements(d, 10, 5), "dynamic_array swap of two inline arrays");
+	baseC.swap(b);
+	AssertMsg(HasElements(c, 0, 24) && HasElements(b, 0, 3), "swap of inline and heap arrays through dynamic_array&");
+
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	dynamic_array<int> moved (kMemTempAlloc);
+	PushElements(d, 15, 1);
+	moved = DYNAMIC_ARRAY_MOVE(baseD);
+	AssertMsg(HasElements(moved, 10, 6) && d.empty() && d.uses_inline_storage(), "move out of an inline array copies the elements");
+	moved.clear();
+	PushElements(d, 0, 2);
+	d.push_back(2);
+	AssertMsg(HasElements(d, 0, 3) && d.uses_inline_storage(), "inline storage reused after the move");
+#endif
+
+	// external data is left to its owner
+	int external[3] = { 1, 2, 3 };
+	b.assign_external(external, external + 3);
+	AssertMsg(HasElements(b, 1, 3) && !b.uses_inline_storage(), "assign_external");
+	dynamic_array<int>& baseB = b;
+	baseB.clear();
+	PushElements(baseB, 0, 4);
+	AssertMsg(HasElements(b, 0, 4) && external[0] == 1 && external[2] == 3, "clear releases external data");
+}
+
+#endif // #if ENABLE_UNIT_TESTS
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "dynamic_array.h"
+
+// small_dynamic_array - dynamic_array with room for N elements inside the object
+//
+// features:
+//  . no allocation until more than N elements are stored, beyond that it spills to the memory label like dynamic_array
+//  . it is a dynamic_array, so it can be passed where a dynamic_array& is expected. The inline storage is marked in the
+//		capacity, dynamic_array copies the inline elements instead of handing the storage over when swapping or moving.
+//		Through a dynamic_array& clear() keeps the inline storage, swap and move may leave the elements on the heap.
+//  . elements have to be trivially copyable, the inline ones are moved with memcpy and never destroyed
+//  . clear() and shrink_to_fit() go back to the inline storage when the elements fit
+//  . the inline elements are seen as external data by dynamic_array, assign_external and set_owns_data work as usual
+//
+template <typename T, size_t N, size_t align = AlignOfType<T>::align, MemLabelIdentifier defaultLabel = kMemDynamicArrayId, size_t growthPercent = DYNAMIC_ARRAY_GROWTH_PERCENT>
+struct small_dynamic_array : public dynamic_array<T, align, defaultLabel, growthPercent>
+{
+	typedef dynamic_array<T, align, defaultLabel, growthPercent> base_type;
+
+public:
+
+	small_dynamic_array()
+	{
+		use_inline_storage();
+	}
+
+	small_dynamic_array(MemLabelRef label) : base_type(label)
+	{
+		use_inline_storage();
+	}
+
+	explicit small_dynamic_array (size_t size, MemLabelRef label) : base_type(label)
+	{
+		use_inline_storage();
+		this->resize_uninitialized(size);
+	}
+
+	small_dynamic_array (size_t size, T const& init_value, MemLabelRef label) : base_type(label)
+	{
+		use_inline_storage();
+		this->resize_initialized(size, init_value);
+	}
+
+	small_dynamic_array(const small_dynamic_array& other) : base_type(other.m_label)
+	{
+		use_inline_storage();
+		this->assign(other.begin(), other.end());
+	}
+
+	small_dynamic_array& operator=(const small_dynamic_array& other)
+	{
+		if (&other != this)
+			this->assign(other.begin(), other.end());
+		return *this;
+	}
+
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	small_dynamic_array(small_dynamic_array&& other) : base_type(other.m_label)
+	{
+		use_inline_storage();
+		take(other);
+	}
+
+	small_dynamic_array& operator=(small_dynamic_array&& other)
+	{
+		if (&other != this)
+		{
+			clear();
+			take(other);
+		}
+		return *this;
+	}
+#endif
+
+	void clear()
+	{
+		base_type::clear();
+		use_inline_storage();
+	}
+
+	void shrink_to_fit()
+	{
+		if (uses_inline_storage() || !this->owns_data())
+			return;
+
+		if (this->m_size > N)
+		{
+			base_type::shrink_to_fit();
+			return;
+		}
+
+		T* heapData = this->m_data;
+		size_t size = this->m_size;
+		use_inline_storage();
+		memcpy(this->m_data, heapData, size * sizeof(T));
+		this->m_size = size;
+		this->deallocate(heapData);
+	}
+
+	void swap(small_dynamic_array& other)
+	{
+		if (!uses_inline_storage() && !other.uses_inline_storage())
+		{
+			base_type::swap(other);
+			return;
+		}
+
+		small_dynamic_array temp(this->m_label);
+		temp.take(*this);
+		take(other);
+		other.take(temp);
+	}
+
+	void set_memory_label (MemLabelRef label)
+	{
+		Assert(uses_inline_storage());
+		this->m_label = label;
+	}
+
+	bool uses_inline_storage() const { return this->m_data == inline_data(); }
+	static size_t inline_capacity() { return N; }
+
+private:
+
+	void use_inline_storage()
+	{
+		CompileTimeAssert(IsTriviallyCopyable<T>::result, "small_dynamic_array elements have to be trivially copyable");
+		this->m_data = inline_data();
+		this->m_size = 0;
+		this->m_capacity = N | base_type::k_reference_bit | base_type::k_inline_bit;
+	}
+
+	// moves the elements of other into this empty array, other is left empty on its inline storage
+	void take(small_dynamic_array& other)
+	{
+		Assert(uses_inline_storage() && this->empty());
+
+		this->m_label = other.m_label;
+		if (other.uses_inline_storage())
+		{
+			memcpy(this->m_data, other.m_data, other.m_size * sizeof(T));
+			this->m_size = other.m_size;
+		}
+		else
+		{
+			this->m_data = other.m_data;
+			this->m_size = other.m_size;
+			this->m_capacity = other.m_capacity;
+		}
+		other.use_inline_storage();
+	}
+
+	T* inline_data() const { return reinterpret_cast<T*> (AlignPtr(const_cast<char*> (m_inline), align)); }
+
+	char m_inline[N * sizeof(T) + align - 1];
+};
+
+// a better match than the dynamic_array swap, keeps the elements inline where they fit
+template <typename T, size_t N, size_t align, MemLabelIdentifier defaultLabel, size_t growthPercent>
+inline void swap(small_dynamic_array<T, N, align, defaultLabel, growthPercent>& lhs, small_dynamic_array<T, N, align, defaultLabel, growthPercent>& rhs)
+{
+	lhs.swap(rhs);
+}
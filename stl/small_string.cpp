@@ -0,0 +1,118 @@
+#include "UnityPrefix.h"
+#include "small_string.h"
+
+#if ENABLE_UNIT_TESTS
+
+#include "Word.h"
+#include <vector>
+
+double GetTimeSinceStartup();
+
+namespace
+{
+	template <typename String>
+	bool IsInline(const String& str)
+	{
+		const char* chars = str.c_str();
+		return chars >= reinterpret_cast<const char*> (&str) && chars < reinterpret_cast<const char*> (&str + 1);
+	}
+}
+
+void TestSmallString()
+{
+#if !ENABLE_MEM_PROFILER
+	CompileTimeAssert(sizeof(small_string) == 24 + 8 || sizeof(void*) != 8, "small_string is 32 bytes on 64 bit platforms");
+#endif
+
+	MemLabelId label (kMemStringId, NULL);
+	small_string empty;
+	AssertMsg(empty.empty() && empty.c_str()[0] == 0 && IsInline(empty), "empty small_string");
+
+	// up to 23 characters stay inside the object
+	small_string shortString ("23 characters long text", label);
+	AssertMsg(shortString.size() == 23 && IsInline(shortString) && shortString == "23 characters long text", "inline small_string");
+	shortString += '!';
+	AssertMsg(shortString.size() == 24 && !IsInline(shortString) && shortString == "23 characters long text!", "small_string spilled to the heap");
+	shortString.resize(5);
+	shortString.shrink_to_fit();
+	AssertMsg(IsInline(shortString) && shortString == "23 ch", "shrink_to_fit goes back inline");
+
+	// conversions
+	UnityStr unityStr = small_string("converted");
+	small_string fromUnityStr (unityStr);
+	std::string stdString = fromUnityStr;
+	AssertMsg(unityStr == "converted" && fromUnityStr == unityStr && stdString == "converted", "conversions");
+	AssertMsg(fromUnityStr.get_memory_label().label == kMemStringId, "default label");
+
+	// copies keep the label of the source
+	small_string tempString ("a string that is too long for the inline buffer", MemLabelId(kMemTempAllocId, NULL));
+	small_string copy (tempString);
+	AssertMsg(copy.get_memory_label().label == kMemTempAllocId && copy == tempString && copy.c_str() != tempString.c_str(), "copy");
+
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	const char* heapChars = copy.c_str();
+	small_string moved (std::move(copy));
+	AssertMsg(moved.c_str() == heapChars && copy.empty() && IsInline(copy), "move takes the heap buffer");
+#endif
+
+	// random operations against std::string, including appending a string to itself
+	srand(1);
+	small_string str;
+	std::string expected;
+	for (int i = 0; i < 100000; i++)
+	{
+		switch (rand() % 9)
+		{
+		case 0: { std::string value = Format("%d", rand()); str.assign(value.c_str()); expected = value; break; }
+		case 1: { std::string value = Format("-%d", rand() % 1000); str += value.c_str(); expected += value; break; }
+		case 2: str.push_back('x'); expected.push_back('x'); break;
+		case 3: { size_t n = rand() % (str.size() + 1); str.append(str.c_str(), n); expected.append(expected.c_str(), n); break; }
+		case 4: { size_t n = rand() % 40; str.resize(n, 'r'); expected.resize(n, 'r'); break; }
+		case 5: str.shrink_to_fit(); break;
+		case 6: { small_string other (str); small_string third ("third"); other.swap(third); AssertMsg(third == str && other == "third", "swap"); break; }
+		case 7: if (rand() % 4 == 0) { str.clear(); expected.clear(); } break;
+		default: { size_t offset = rand() % (str.size() + 1); str.assign(str.c_str() + offset, str.size() - offset); expected.assign(expected, offset, std::string::npos); break; }
+		}
+		AssertMsg(str.size() == expected.size() && str == expected && str.c_str()[str.size()] == 0, "small_string differs after %d operations", i);
+		AssertMsg(IsInline(str) == (str.capacity() == small_string::inline_capacity()), "inline storage");
+		if (expected.size() > 1000)
+		{
+			str.clear();
+			expected.clear();
+		}
+	}
+}
+
+void BenchmarkSmallString()
+{
+	// copies of 16 character names, e.g. object names passed around by value
+	const int kCount = 1000000;
+	std::vector<std::string> names;
+	for (int i = 0; i < 64; i++)
+		names.push_back(Format("GameObject %05d", i));
+
+	size_t sum = 0;
+	double t0 = GetTimeSinceStartup();
+	for (int i = 0; i < kCount; i++)
+	{
+		UnityStr str (names[i & 63].c_str());
+		UnityStr copy (str);
+		sum += copy.size();
+	}
+	double t1 = GetTimeSinceStartup();
+	for (int i = 0; i < kCount; i++)
+	{
+		small_string str (names[i & 63].c_str());
+		small_string copy (str);
+		sum += copy.size();
+	}
+	double t2 = GetTimeSinceStartup();
+	printf_console("16 character strings, construct and copy: UnityStr %.2fms, small_string %.2fms for %i strings (%i)\n",
+		(t1-t0) * 1000.0, (t2-t1) * 1000.0, kCount, (int)sum);
+
+	// Linux VM, gcc -O2, libstdc++ with its 15 character SSO. UnityStr always allocates here, its copy constructor
+	// goes through c_str() and length():
+	// 16 character strings, construct and copy: UnityStr 44.10ms, small_string 11.26ms for 1000000 strings (32000000)
+}
+
+#endif // #if ENABLE_UNIT_TESTS
@@ -0,0 +1,353 @@
+#pragma once
+
+#include "MemoryMacros.h"
+#include "StaticAssert.h"
+#include "STLAllocator.h"
+#include <string.h>
+#include <algorithm>
+
+// basic_small_string<N> - string that keeps up to N characters inside the object
+// small_string - 23 characters inline, 32 bytes on 64 bit platforms
+//
+// features:
+//  . strings of up to N characters never allocate, longer ones go to the memory label given at run time
+//  . the label is stored as 16 bits next to the inline size, so small_string is as big as the inline buffer plus 8 bytes.
+//		With the memory profiler the label keeps its root reference and doesn't fit into the footprint.
+//  . converts from and to UnityStr / std::basic_string and const char* by copying the characters, no reallocation
+//  . copies keep the label of the source, assignment keeps the label of the target like dynamic_array
+//  . clear() keeps the heap buffer, shrink_to_fit() goes back to the inline buffer when the characters fit
+//
+template <size_t N = 23, MemLabelIdentifier defaultLabel = kMemStringId>
+class basic_small_string
+{
+public:
+	typedef char			value_type;
+	typedef size_t			size_type;
+	typedef char*			iterator;
+	typedef const char*		const_iterator;
+	static const size_t npos = (size_t)-1;
+
+	basic_small_string() { init(MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER())); }
+	basic_small_string(MemLabelRef label) { init(label); }
+
+	basic_small_string(const char* str) { init(MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER())); assign(str, strlen(str)); }
+	basic_small_string(const char* str, MemLabelRef label) { init(label); assign(str, strlen(str)); }
+	basic_small_string(const char* str, size_t length, MemLabelRef label) { init(label); assign(str, length); }
+
+	template <typename Alloc>
+	basic_small_string(const std::basic_string<char, std::char_traits<char>, Alloc>& str) { init(MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER())); assign(str.data(), str.size()); }
+	template <typename Alloc>
+	basic_small_string(const std::basic_string<char, std::char_traits<char>, Alloc>& str, MemLabelRef label) { init(label); assign(str.data(), str.size()); }
+
+	basic_small_string(const basic_small_string& other) { init(other.get_memory_label()); assign(other.data(), other.size()); }
+
+	~basic_small_string() { deallocate(); }
+
+	basic_small_string& operator=(const basic_small_string& other) { if (&other != this) assign(other.data(), other.size()); return *this; }
+	basic_small_string& operator=(const char* str) { return assign(str, strlen(str)); }
+	template <typename Alloc>
+	basic_small_string& operator=(const std::basic_string<char, std::char_traits<char>, Alloc>& str) { return assign(str.data(), str.size()); }
+
+#if SUPPORT_CPP0X_RVALUE_REFERENCES
+	// takes over the heap buffer and the label of other, which is left empty
+	basic_small_string(basic_small_string&& other) { init(other.get_memory_label()); take(other); }
+
+	basic_small_string& operator=(basic_small_string&& other)
+	{
+		if (&other != this)
+		{
+			deallocate();
+			init(other.get_memory_label());
+			take(other);
+		}
+		return *this;
+	}
+#endif
+
+	operator UnityStr () const { return UnityStr(data(), (int)size()); }
+	template <typename Alloc>
+	operator std::basic_string<char, std::char_traits<char>, Alloc> () const { return std::basic_string<char, std::char_traits<char>, Alloc>(data(), size()); }
+
+	// str may point into this string
+	basic_small_string& assign(const char* str, size_t length)
+	{
+		if (length > capacity())
+		{
+			// copy before the old buffer goes away
+			char* newData = allocate(length);
+			memcpy(newData, str, length);
+			deallocate();
+			set_heap(newData, length);
+		}
+		else
+			memmove(data(), str, length);
+		set_size(length);
+		return *this;
+	}
+	basic_small_string& assign(const char* str) { return assign(str, strlen(str)); }
+
+	basic_small_string& append(const char* str, size_t length)
+	{
+		const size_t oldSize = size();
+		if (oldSize + length > capacity())
+		{
+			// str may be in the buffer that grow frees
+			const char* oldData = data();
+			const bool aliased = str >= oldData && str < oldData + oldSize;
+			const size_t offset = str - oldData;
+			grow_for(oldSize + length);
+			if (aliased)
+				str = data() + offset;
+		}
+		memmove(data() + oldSize, str, length);
+		set_size(oldSize + length);
+		return *this;
+	}
+	basic_small_string& append(const char* str) { return append(str, strlen(str)); }
+	basic_small_string& append(size_t count, char c)
+	{
+		const size_t oldSize = size();
+		if (oldSize + count > capacity())
+			grow_for(oldSize + count);
+		memset(data() + oldSize, c, count);
+		set_size(oldSize + count);
+		return *this;
+	}
+
+	basic_small_string& operator+=(const basic_small_string& other) { return append(other.data(), other.size()); }
+	basic_small_string& operator+=(const char* str) { return append(str, strlen(str)); }
+	basic_small_string& operator+=(char c) { push_back(c); return *this; }
+
+	void push_back(char c)
+	{
+		const size_t oldSize = size();
+		if (oldSize == capacity())
+			grow_for(oldSize + 1);
+		data()[oldSize] = c;
+		set_size(oldSize + 1);
+	}
+
+	void resize(size_t size, char c = 0)
+	{
+		const size_t oldSize = this->size();
+		if (size > oldSize)
+			append(size - oldSize, c);
+		else
+			set_size(size);
+	}
+
+	void reserve(size_t capacity)
+	{
+		if (capacity > this->capacity())
+			grow(capacity);
+	}
+
+	void clear() { set_size(0); }
+
+	void shrink_to_fit()
+	{
+		if (!is_heap())
+			return;
+		const size_t size = m_heap.size;
+		if (size > N)
+		{
+			if (size < m_heap.capacity)
+			{
+				char* newData = allocate(size);
+				memcpy(newData, m_heap.data, size);
+				deallocate();
+				set_heap(newData, size);
+				set_size(size);
+			}
+			return;
+		}
+
+		char* heapData = m_heap.data;
+		memcpy(m_inline, heapData, size);
+		m_inlineSize = (UInt8)size;
+		m_inline[size] = 0;
+		UNITY_FREE(get_memory_label(), heapData);
+	}
+
+	void swap(basic_small_string& other)
+	{
+		basic_small_string temp(get_memory_label());
+		temp.take(*this);
+		init(other.get_memory_label());
+		take(other);
+		other.init(temp.get_memory_label());
+		other.take(temp);
+	}
+
+	const char* c_str() const { return data(); }
+	const char* data() const { return is_heap() ? m_heap.data : m_inline; }
+	char* data() { return is_heap() ? m_heap.data : m_inline; }
+
+	size_t size() const { return is_heap() ? m_heap.size : m_inlineSize; }
+	size_t length() const { return size(); }
+	size_t capacity() const { return is_heap() ? m_heap.capacity : N; }
+	bool empty() const { return size() == 0; }
+	static size_t inline_capacity() { return N; }
+	bool uses_inline_storage() const { return !is_heap(); }
+
+	char& operator[] (size_t index) { DebugAssert(index < size()); return data()[index]; }
+	const char& operator[] (size_t index) const { DebugAssert(index < size()); return data()[index]; }
+
+	iterator begin() { return data(); }
+	iterator end() { return data() + size(); }
+	const_iterator begin() const { return data(); }
+	const_iterator end() const { return data() + size(); }
+
+	size_t find(char c, size_t pos = 0) const
+	{
+		if (pos >= size())
+			return npos;
+		const char* found = static_cast<const char*> (memchr(data() + pos, c, size() - pos));
+		return found != NULL ? found - data() : npos;
+	}
+
+	int compare(const char* str, size_t length) const
+	{
+		const size_t size = this->size();
+		int result = memcmp(data(), str, std::min(size, length));
+		if (result != 0)
+			return result;
+		return size < length ? -1 : (size > length ? 1 : 0);
+	}
+
+	friend bool operator==(const basic_small_string& lhs, const basic_small_string& rhs) { return lhs.size() == rhs.size() && memcmp(lhs.data(), rhs.data(), lhs.size()) == 0; }
+	friend bool operator!=(const basic_small_string& lhs, const basic_small_string& rhs) { return !(lhs == rhs); }
+	friend bool operator<(const basic_small_string& lhs, const basic_small_string& rhs) { return lhs.compare(rhs.data(), rhs.size()) < 0; }
+	friend bool operator==(const basic_small_string& lhs, const char* rhs) { return strcmp(lhs.c_str(), rhs) == 0; }
+	friend bool operator!=(const basic_small_string& lhs, const char* rhs) { return strcmp(lhs.c_str(), rhs) != 0; }
+	friend bool operator==(const char* lhs, const basic_small_string& rhs) { return strcmp(lhs, rhs.c_str()) == 0; }
+	friend bool operator!=(const char* lhs, const basic_small_string& rhs) { return strcmp(lhs, rhs.c_str()) != 0; }
+
+	template <typename Alloc>
+	friend bool operator==(const basic_small_string& lhs, const std::basic_string<char, std::char_traits<char>, Alloc>& rhs) { return lhs.size() == rhs.size() && memcmp(lhs.data(), rhs.data(), lhs.size()) == 0; }
+	template <typename Alloc>
+	friend bool operator!=(const basic_small_string& lhs, const std::basic_string<char, std::char_traits<char>, Alloc>& rhs) { return !(lhs == rhs); }
+
+	MemLabelId get_memory_label() const
+	{
+#if ENABLE_MEM_PROFILER
+		return m_label;
+#else
+		return MemLabelId((MemLabelIdentifier)m_labelId, NULL);
+#endif
+	}
+
+	// only while the characters are inline, a heap buffer has to be freed with the label it came from
+	void set_memory_label(MemLabelRef label)
+	{
+		Assert(!is_heap());
+		set_label(label);
+	}
+
+private:
+	enum { kHeap = 0xFF };
+
+	struct HeapData
+	{
+		char*	data;
+		size_t	size;
+		size_t	capacity;
+	};
+
+	bool is_heap() const { return m_inlineSize == kHeap; }
+
+	void init(MemLabelRef label)
+	{
+		CompileTimeAssert(N < kHeap, "basic_small_string inline capacity has to fit into 8 bits");
+		set_label(label);
+		m_inlineSize = 0;
+		m_inline[0] = 0;
+	}
+
+	void set_label(MemLabelRef label)
+	{
+#if ENABLE_MEM_PROFILER
+		m_label = label;
+#endif
+		Assert(label.label <= 0xFFFF);
+		m_labelId = (UInt16)label.label;
+	}
+
+	void set_size(size_t size)
+	{
+		if (is_heap())
+			m_heap.size = size;
+		else
+			m_inlineSize = (UInt8)size;
+		data()[size] = 0;
+	}
+
+	void set_heap(char* data, size_t capacity)
+	{
+		m_heap.data = data;
+		m_heap.size = 0;
+		m_heap.capacity = capacity;
+		m_inlineSize = kHeap;
+	}
+
+	char* allocate(size_t capacity) { return static_cast<char*> (UNITY_MALLOC(get_memory_label(), capacity + 1)); }
+
+	void deallocate()
+	{
+		if (is_heap())
+			UNITY_FREE(get_memory_label(), m_heap.data);
+	}
+
+	void grow(size_t capacity)
+	{
+		const size_t size = this->size();
+		char* newData = allocate(capacity);
+		memcpy(newData, data(), size);
+		deallocate();
+		set_heap(newData, capacity);
+		set_size(size);
+	}
+
+	// at least doubles the capacity, so appending one character at a time doesn't copy the string every time
+	void grow_for(size_t size)
+	{
+		grow(std::max(size, capacity() * 2));
+	}
+
+	// moves the characters of other into this empty string, other is left empty on its inline buffer
+	void take(basic_small_string& other)
+	{
+		Assert(!is_heap() && empty());
+		if (other.is_heap())
+		{
+			m_heap = other.m_heap;
+			m_inlineSize = kHeap;
+		}
+		else
+		{
+			memcpy(m_inline, other.m_inline, other.m_inlineSize + 1);
+			m_inlineSize = other.m_inlineSize;
+		}
+		other.m_inlineSize = 0;
+		other.m_inline[0] = 0;
+	}
+
+	union
+	{
+		char		m_inline[N + 1];
+		HeapData	m_heap;
+	};
+	UInt8			m_inlineSize;
+	UInt16			m_labelId;
+#if ENABLE_MEM_PROFILER
+	MemLabelId		m_label;
+#endif
+};
+
+template <size_t N, MemLabelIdentifier defaultLabel>
+inline void swap(basic_small_string<N, defaultLabel>& lhs, basic_small_string<N, defaultLabel>& rhs)
+{
+	lhs.swap(rhs);
+}
+
+typedef basic_small_string<> small_string;
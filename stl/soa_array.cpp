@@ -0,0 +1,104 @@
+#include "UnityPrefix.h"
+#include "soa_array.h"
+
+#if ENABLE_UNIT_TESTS
+
+double GetTimeSinceStartup();
+
+namespace
+{
+	struct BenchmarkFloat3
+	{
+		float x, y, z;
+	};
+
+	// 32 bytes per particle, the lifetime pass only needs 4 of them
+	struct BenchmarkParticle
+	{
+		BenchmarkFloat3	position;
+		BenchmarkFloat3	velocity;
+		float			lifetime;
+		int				flags;
+	};
+}
+
+void BenchmarkSoaArray()
+{
+	// particles in an array of structs against the same fields in columns: a pass over the lifetimes only,
+	// and a pass moving the positions by the velocities
+	const int kCount = 1 << 20;
+	const int kIterations = 20;
+	const float kDeltaTime = 0.01f;
+
+	dynamic_array<BenchmarkParticle> aos(kMemTempAlloc);
+	soa_array<BenchmarkFloat3, BenchmarkFloat3, float, int> soa(kMemTempAlloc);
+	aos.reserve(kCount);
+	soa.reserve(kCount);
+	srand(1);
+	for (int i = 0; i < kCount; i++)
+	{
+		BenchmarkParticle particle = { { 0.0f, 0.0f, 0.0f }, { (float)(rand() % 100), 1.0f, 0.5f }, (float)(rand() % 1000) * 0.01f, 0 };
+		aos.push_back(particle);
+		soa.push_back(particle.position, particle.velocity, particle.lifetime, particle.flags);
+	}
+
+	int alive = 0;
+	double t0 = GetTimeSinceStartup();
+	for (int it = 0; it < kIterations; it++)
+	{
+		for (int i = 0; i < kCount; i++)
+		{
+			aos[i].lifetime -= kDeltaTime;
+			alive += aos[i].lifetime > 0.0f ? 1 : 0;
+		}
+	}
+	double t1 = GetTimeSinceStartup();
+	for (int it = 0; it < kIterations; it++)
+	{
+		soa_column<float> lifetimes = soa.column<2>();
+		for (int i = 0; i < kCount; i++)
+		{
+			lifetimes[i] -= kDeltaTime;
+			alive -= lifetimes[i] > 0.0f ? 1 : 0;
+		}
+	}
+	double t2 = GetTimeSinceStartup();
+	printf_console("lifetime pass: dynamic_array of structs %.2fms, soa_array %.2fms for %i particles (%i)\n",
+		(t1-t0) * 1000.0, (t2-t1) * 1000.0, kCount * kIterations, alive);
+
+	float sum = 0.0f;
+	t0 = GetTimeSinceStartup();
+	for (int it = 0; it < kIterations; it++)
+	{
+		for (int i = 0; i < kCount; i++)
+		{
+			BenchmarkParticle& particle = aos[i];
+			particle.position.x += particle.velocity.x * kDeltaTime;
+			particle.position.y += particle.velocity.y * kDeltaTime;
+			particle.position.z += particle.velocity.z * kDeltaTime;
+		}
+		sum += aos[it].position.x;
+	}
+	t1 = GetTimeSinceStartup();
+	for (int it = 0; it < kIterations; it++)
+	{
+		soa_column<BenchmarkFloat3> positions = soa.column<0>();
+		soa_column<BenchmarkFloat3> velocities = soa.column<1>();
+		for (int i = 0; i < kCount; i++)
+		{
+			positions[i].x += velocities[i].x * kDeltaTime;
+			positions[i].y += velocities[i].y * kDeltaTime;
+			positions[i].z += velocities[i].z * kDeltaTime;
+		}
+		sum -= positions[it].x;
+	}
+	t2 = GetTimeSinceStartup();
+	printf_console("position pass: dynamic_array of structs %.2fms, soa_array %.2fms for %i particles (%f)\n",
+		(t1-t0) * 1000.0, (t2-t1) * 1000.0, kCount * kIterations, sum);
+
+	// Linux VM, gcc -O2, 32 MB of particles against 4 MB of lifetimes and 24 MB of positions and velocities:
+	// lifetime pass: dynamic_array of structs 108.08ms, soa_array 9.26ms for 20971520 particles (0)
+	// position pass: dynamic_array of structs 124.27ms, soa_array 67.08ms for 20971520 particles (-0.000003)
+}
+
+#endif // #if ENABLE_UNIT_TESTS
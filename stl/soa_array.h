@@ -0,0 +1,247 @@
+#pragma once
+
+#include "dynamic_array.h"
+
+// soa_array - structure of arrays, every field of the element is stored in its own column
+//
+// features:
+//  . loops touching a few fields only load those fields, e.g. soa_array<Vector3f, float, int>
+//  . all columns live in one allocation from the memory label, each column starts on a kColumnAlignment boundary
+//  . up to 4 columns, column<N>() returns a soa_column over the elements of column N
+//  . erase_swap_back removes in O(1) by moving the last element into the hole, the order is not kept
+//  . columns have to be trivially copyable, they are moved with memcpy
+//  . grows X2 on reallocation, push_back(void) and resize_uninitialized do NOT initialize members!
+//
+struct soa_unused {};
+
+// typed view of one column
+template <typename T>
+struct soa_column
+{
+	soa_column (T* data, size_t size) : m_data(data), m_size(size) {}
+
+	T* begin() const { return m_data; }
+	T* end() const { return m_data + m_size; }
+	T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	T& operator[] (size_t index) const { DebugAssert(index < m_size); return m_data[index]; }
+
+private:
+	T*		m_data;
+	size_t	m_size;
+};
+
+template <int index, typename T0, typename T1, typename T2, typename T3> struct soa_column_type;
+template <typename T0, typename T1, typename T2, typename T3> struct soa_column_type<0, T0, T1, T2, T3> { typedef T0 type; };
+template <typename T0, typename T1, typename T2, typename T3> struct soa_column_type<1, T0, T1, T2, T3> { typedef T1 type; };
+template <typename T0, typename T1, typename T2, typename T3> struct soa_column_type<2, T0, T1, T2, T3> { typedef T2 type; };
+template <typename T0, typename T1, typename T2, typename T3> struct soa_column_type<3, T0, T1, T2, T3> { typedef T3 type; };
+
+template <typename T> struct soa_column_size { enum { size = sizeof(T) }; };
+template <> struct soa_column_size<soa_unused> { enum { size = 0 }; };
+
+template <typename T0, typename T1, typename T2 = soa_unused, typename T3 = soa_unused, MemLabelIdentifier defaultLabel = kMemDynamicArrayId>
+struct soa_array
+{
+public:
+	enum
+	{
+		kColumnCount = 4,
+		kColumnAlignment = 16 // SSE
+	};
+
+	template <int index>
+	struct column_type
+	{
+		typedef typename soa_column_type<index, T0, T1, T2, T3>::type type;
+	};
+
+	soa_array() : m_size(0), m_capacity(0), m_label(defaultLabel, NULL)
+	{
+		m_label = MemLabelId(defaultLabel, GET_CURRENT_ALLOC_ROOT_HEADER());
+		memset(m_columns, 0, sizeof(m_columns));
+	}
+
+	soa_array(MemLabelRef label) : m_size(0), m_capacity(0), m_label(label)
+	{
+		memset(m_columns, 0, sizeof(m_columns));
+	}
+
+	soa_array(const soa_array& other) : m_size(0), m_capacity(0), m_label(other.m_label)
+	{
+		memset(m_columns, 0, sizeof(m_columns));
+		*this = other;
+	}
+
+	~soa_array()
+	{
+		UNITY_FREE(m_label, m_columns[0]);
+	}
+
+	soa_array& operator=(const soa_array& other)
+	{
+		if (&other == this)
+			return *this;
+
+		m_size = 0;
+		reserve(other.m_size);
+		if (other.m_size != 0)
+		{
+			for (int i = 0; i < kColumnCount; i++)
+				memcpy(m_columns[i], other.m_columns[i], other.m_size * column_size(i));
+		}
+		m_size = other.m_size;
+		return *this;
+	}
+
+	void swap(soa_array& other) throw()
+	{
+		if (m_columns[0]) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(m_columns[0], m_label, other.m_label.GetRootHeader());
+		if (other.m_columns[0]) UNITY_TRANSFER_OWNERSHIP_TO_HEADER(other.m_columns[0], other.m_label, m_label.GetRootHeader());
+		for (int i = 0; i < kColumnCount; i++)
+			std::swap(m_columns[i], other.m_columns[i]);
+		std::swap(m_size, other.m_size);
+		std::swap(m_capacity, other.m_capacity);
+		std::swap(m_label, other.m_label);
+	}
+
+	// frees the memory, use resize_uninitialized(0) to clear w/o freeing
+	void clear()
+	{
+		UNITY_FREE(m_label, m_columns[0]);
+		memset(m_columns, 0, sizeof(m_columns));
+		m_size = 0;
+		m_capacity = 0;
+	}
+
+	// adds an element and returns its index, the fields are not initialized
+	size_t push_back()
+	{
+		if (m_size == m_capacity)
+			reserve(std::max<size_t>(m_capacity * 2, 1));
+		return m_size++;
+	}
+
+	size_t push_back(const T0& v0, const T1& v1, const T2& v2 = T2(), const T3& v3 = T3())
+	{
+		size_t index = push_back();
+		column<0>()[index] = v0;
+		column<1>()[index] = v1;
+		store(m_columns[2], index, v2);
+		store(m_columns[3], index, v3);
+		return index;
+	}
+
+	void pop_back()
+	{
+		Assert(m_size >= 1);
+		m_size--;
+	}
+
+	// moves the last element to index, which changes the index of that element
+	void erase_swap_back(size_t index)
+	{
+		Assert(index < m_size);
+		m_size--;
+		if (index == m_size)
+			return;
+
+		for (int i = 0; i < kColumnCount; i++)
+		{
+			size_t size = column_size(i);
+			memcpy(m_columns[i] + index * size, m_columns[i] + m_size * size, size);
+		}
+	}
+
+	void resize_uninitialized(size_t size)
+	{
+		reserve(size);
+		m_size = size;
+	}
+
+	void reserve(size_t inCapacity)
+	{
+		if (m_capacity >= inCapacity)
+			return;
+
+		UInt8* columns[kColumnCount];
+		UInt8* data = static_cast<UInt8*> (UNITY_MALLOC_ALIGNED(m_label, layout(inCapacity, columns), kColumnAlignment));
+		for (int i = 0; i < kColumnCount; i++)
+		{
+			columns[i] = data + (size_t)columns[i];
+			if (m_size != 0)
+				memcpy(columns[i], m_columns[i], m_size * column_size(i));
+		}
+
+		UNITY_FREE(m_label, m_columns[0]);
+		memcpy(m_columns, columns, sizeof(m_columns));
+		m_capacity = inCapacity;
+	}
+
+	template <int index>
+	soa_column<typename column_type<index>::type> column()
+	{
+		CompileTimeAssert(index >= 0 && index < kColumnCount, "invalid column");
+		typedef typename column_type<index>::type ColumnType;
+		CompileTimeAssert((!IsSameType<ColumnType, soa_unused>::result), "column is not used");
+		return soa_column<ColumnType>(reinterpret_cast<ColumnType*> (m_columns[index]), m_size);
+	}
+
+	template <int index>
+	soa_column<const typename column_type<index>::type> column() const
+	{
+		typedef typename column_type<index>::type ColumnType;
+		soa_column<ColumnType> result = const_cast<soa_array*> (this)->template column<index>();
+		return soa_column<const ColumnType>(result.data(), result.size());
+	}
+
+	bool empty () const { return m_size == 0; }
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_capacity; }
+
+	void set_memory_label (MemLabelRef label)
+	{
+		Assert(m_columns[0] == NULL);
+		m_label = label;
+	}
+
+private:
+
+	static size_t column_size (int index)
+	{
+		static const size_t sizes[kColumnCount] = { soa_column_size<T0>::size, soa_column_size<T1>::size, soa_column_size<T2>::size, soa_column_size<T3>::size };
+		return sizes[index];
+	}
+
+	// returns the size of a block holding capacity elements, offsets receives the start of each column
+	static size_t layout (size_t capacity, UInt8* offsets[kColumnCount])
+	{
+		CompileTimeAssert(IsTriviallyCopyable<T0>::result && IsTriviallyCopyable<T1>::result && IsTriviallyCopyable<T2>::result && IsTriviallyCopyable<T3>::result,
+			"soa_array columns have to be trivially copyable");
+		CompileTimeAssert(ALIGN_OF(T0) <= kColumnAlignment && ALIGN_OF(T1) <= kColumnAlignment && ALIGN_OF(T2) <= kColumnAlignment && ALIGN_OF(T3) <= kColumnAlignment,
+			"soa_array column type alignment is too large, it has to be at most kColumnAlignment");
+
+		size_t offset = 0;
+		for (int i = 0; i < kColumnCount; i++)
+		{
+			offsets[i] = reinterpret_cast<UInt8*> (offset);
+			offset += (capacity * column_size(i) + kColumnAlignment - 1) & ~(size_t)(kColumnAlignment - 1);
+		}
+		return offset;
+	}
+
+	template <typename T>
+	static void store (UInt8* data, size_t index, const T& value) { reinterpret_cast<T*> (data)[index] = value; }
+	static void store (UInt8* data, size_t index, const soa_unused& value) {}
+
+	UInt8*		m_columns[kColumnCount]; // m_columns[0] is the start of the allocation
+	size_t		m_size;
+	size_t		m_capacity;
+	MemLabelId	m_label;
+};
+
+template <typename T0, typename T1, typename T2, typename T3, MemLabelIdentifier defaultLabel>
+inline void swap(soa_array<T0, T1, T2, T3, defaultLabel>& lhs, soa_array<T0, T1, T2, T3, defaultLabel>& rhs)
+{
+	lhs.swap(rhs);
+}
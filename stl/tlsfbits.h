@@ -56,8 +56,8 @@ tlsf_decl int tlsf_fls(unsigned int word)
 	return bit - 1;
 }
 
-#elif defined (_MSC_VER) && defined (_M_IX86) && (_MSC_VER >= 1400)
-/* Microsoft Visual C++ 2005 support on x86 architectures. */
+#elif defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64)) && (_MSC_VER >= 1400)
+/* Microsoft Visual C++ 2005 support on x86 and x64 architectures. */
 
 #include <intrin.h>
 
@@ -0,0 +1,305 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "BitUtility.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// vector_map / vector_set - associative containers on a sorted dynamic_array
+//
+// features:
+//  . one allocation from the memory label for all entries, no node per entry
+//  . lookups are binary searches over contiguous memory
+//  . insert and erase move the entries behind the position, use them for small or read-mostly data.
+//		To build a large one, push_back_unsorted everything and sort() once, or assign() a range.
+//  . iterators are pointers and walk the entries in order, inserting and erasing invalidates them
+//  . find, count, lower_bound and upper_bound take any key type the Compare functor accepts
+//
+// eytzinger_set - read-only sorted set in Eytzinger (breadth first) order
+//  . for large sets that are built once, the top levels of the search share a few cache lines
+//		and the search does not branch on the comparison
+//
+template <typename Value, typename Key, typename KeyOfValue, typename Compare, MemLabelIdentifier defaultLabel>
+class sorted_vector
+{
+public:
+	typedef Key										key_type;
+	typedef Value									value_type;
+	typedef Compare									key_compare;
+	typedef size_t									size_type;
+	typedef Value*									iterator;
+	typedef const Value*							const_iterator;
+
+	sorted_vector() {}
+	sorted_vector(MemLabelRef label) : m_data(label) {}
+
+	std::pair<iterator, bool> insert(const value_type& value)
+	{
+		iterator i = lower_bound(KeyOfValue()(value));
+		if (i != end() && !m_compare(KeyOfValue()(value), KeyOfValue()(*i)))
+			return std::make_pair(i, false);
+		return std::make_pair(m_data.insert(i, value), true);
+	}
+
+	// replaces the contents with the range, sorted. Of equal keys one is kept.
+	template <typename InputIterator>
+	void assign(InputIterator first, InputIterator last)
+	{
+		m_data.resize_uninitialized(0);
+		for (; first != last; ++first)
+			m_data.push_back(*first);
+		sort();
+	}
+
+	// adds the value without keeping the order, call sort() before the next lookup
+	void push_back_unsorted(const value_type& value)
+	{
+		m_data.push_back(value);
+	}
+
+	// sorts the values added with push_back_unsorted. Of equal keys one is kept.
+	void sort()
+	{
+		std::sort(m_data.begin(), m_data.end(), value_less(m_compare));
+		iterator newEnd = std::unique(m_data.begin(), m_data.end(), value_equivalent(m_compare));
+		m_data.resize_uninitialized(newEnd - m_data.begin());
+	}
+
+	void erase(iterator position) { m_data.erase(position); }
+	void erase(iterator first, iterator last) { m_data.erase(first, last); }
+
+	template <typename K>
+	size_t erase(const K& key)
+	{
+		iterator i = find(key);
+		if (i == end())
+			return 0;
+		m_data.erase(i);
+		return 1;
+	}
+
+	template <typename K>
+	iterator find(const K& key)
+	{
+		iterator i = lower_bound(key);
+		return i != end() && !m_compare(key, KeyOfValue()(*i)) ? i : end();
+	}
+
+	template <typename K>
+	const_iterator find(const K& key) const { return const_cast<sorted_vector*> (this)->find(key); }
+
+	template <typename K>
+	size_t count(const K& key) const { return find(key) != end() ? 1 : 0; }
+
+	// first entry whose key is not less than key
+	template <typename K>
+	iterator lower_bound(const K& key)
+	{
+		iterator first = m_data.begin();
+		size_t count = m_data.size();
+		while (count > 0)
+		{
+			size_t half = count / 2;
+			if (m_compare(KeyOfValue()(first[half]), key))
+			{
+				first += half + 1;
+				count -= half + 1;
+			}
+			else
+				count = half;
+		}
+		return first;
+	}
+
+	// first entry whose key is greater than key
+	template <typename K>
+	iterator upper_bound(const K& key)
+	{
+		iterator first = m_data.begin();
+		size_t count = m_data.size();
+		while (count > 0)
+		{
+			size_t half = count / 2;
+			if (!m_compare(key, KeyOfValue()(first[half])))
+			{
+				first += half + 1;
+				count -= half + 1;
+			}
+			else
+				count = half;
+		}
+		return first;
+	}
+
+	template <typename K>
+	const_iterator lower_bound(const K& key) const { return const_cast<sorted_vector*> (this)->lower_bound(key); }
+
+	template <typename K>
+	const_iterator upper_bound(const K& key) const { return const_cast<sorted_vector*> (this)->upper_bound(key); }
+
+	void reserve(size_t size) { m_data.reserve(size); }
+	void shrink_to_fit() { m_data.shrink_to_fit(); }
+	// frees the memory
+	void clear() { m_data.clear(); }
+	void swap(sorted_vector& other) { m_data.swap(other.m_data); std::swap(m_compare, other.m_compare); }
+
+	iterator begin() { return m_data.begin(); }
+	iterator end() { return m_data.end(); }
+	const_iterator begin() const { return m_data.begin(); }
+	const_iterator end() const { return m_data.end(); }
+
+	value_type& operator[] (size_t index) { return m_data[index]; }
+	const value_type& operator[] (size_t index) const { return m_data[index]; }
+
+	bool empty () const { return m_data.empty(); }
+	size_t size() const { return m_data.size(); }
+	size_t capacity() const { return m_data.capacity(); }
+
+	void set_memory_label (MemLabelRef label) { m_data.set_memory_label(label); }
+
+protected:
+
+	struct value_less
+	{
+		value_less(const Compare& compare) : m_compare(compare) {}
+		bool operator() (const Value& a, const Value& b) const { return m_compare(KeyOfValue()(a), KeyOfValue()(b)); }
+		Compare m_compare;
+	};
+
+	struct value_equivalent
+	{
+		value_equivalent(const Compare& compare) : m_compare(compare) {}
+		bool operator() (const Value& a, const Value& b) const { return !m_compare(KeyOfValue()(a), KeyOfValue()(b)) && !m_compare(KeyOfValue()(b), KeyOfValue()(a)); }
+		Compare m_compare;
+	};
+
+	dynamic_array<Value, AlignOfType<Value>::align, defaultLabel>	m_data;
+	Compare															m_compare;
+};
+
+template <typename Value, typename Key, typename KeyOfValue, typename Compare, MemLabelIdentifier defaultLabel>
+inline void swap(sorted_vector<Value, Key, KeyOfValue, Compare, defaultLabel>& lhs, sorted_vector<Value, Key, KeyOfValue, Compare, defaultLabel>& rhs)
+{
+	lhs.swap(rhs);
+}
+
+template <typename Key>
+struct vector_set_key
+{
+	const Key& operator() (const Key& value) const { return value; }
+};
+
+template <typename Key, typename T>
+struct vector_map_key
+{
+	const Key& operator() (const std::pair<Key, T>& value) const { return value.first; }
+};
+
+// the entries are std::pair<Key, T>, don't change the key through an iterator
+template <typename Key, typename T, typename Compare = std::less<Key>, MemLabelIdentifier defaultLabel = kMemSTLId>
+class vector_map : public sorted_vector<std::pair<Key, T>, Key, vector_map_key<Key, T>, Compare, defaultLabel>
+{
+	typedef sorted_vector<std::pair<Key, T>, Key, vector_map_key<Key, T>, Compare, defaultLabel> base_type;
+
+public:
+	typedef T mapped_type;
+
+	vector_map() {}
+	vector_map(MemLabelRef label) : base_type(label) {}
+
+	T& operator[] (const Key& key)
+	{
+		typename base_type::iterator i = this->lower_bound(key);
+		if (i == this->end() || this->m_compare(key, i->first))
+			i = this->m_data.insert(i, typename base_type::value_type(key, T()));
+		return i->second;
+	}
+};
+
+template <typename Key, typename Compare = std::less<Key>, MemLabelIdentifier defaultLabel = kMemSTLId>
+class vector_set : public sorted_vector<Key, Key, vector_set_key<Key>, Compare, defaultLabel>
+{
+	typedef sorted_vector<Key, Key, vector_set_key<Key>, Compare, defaultLabel> base_type;
+
+public:
+	vector_set() {}
+	vector_set(MemLabelRef label) : base_type(label) {}
+};
+
+
+template <typename T, typename Compare = std::less<T>, MemLabelIdentifier defaultLabel = kMemSTLId>
+class eytzinger_set
+{
+public:
+	typedef T		value_type;
+	typedef size_t	size_type;
+
+	eytzinger_set() {}
+	eytzinger_set(MemLabelRef label) : m_data(label) {}
+
+	// builds the set from a sorted range without duplicates, e.g. a vector_set
+	void assign(const T* sorted_begin, const T* sorted_end)
+	{
+		size_t size = sorted_end - sorted_begin;
+		Assert(size < (1U << 31));
+
+		// node k has its children at 2k and 2k+1, index 0 is not used
+		m_data.clear();
+		m_data.resize_uninitialized(size + 1);
+		size_t used = build(sorted_begin, 0, 1);
+		Assert(used == size);
+	}
+
+	// smallest element that is not less than key, NULL if there is none
+	template <typename K>
+	const T* lower_bound(const K& key) const
+	{
+		const size_t size = this->size();
+		size_t k = 1;
+		while (k <= size)
+			k = 2 * k + (m_compare(m_data[k], key) ? 1 : 0);
+
+		// the last left turn led to the result. Undo the right turns after it and that left turn.
+		k >>= LowestBit(~(UInt32)k) + 1;
+		return k != 0 ? &m_data[k] : NULL;
+	}
+
+	template <typename K>
+	const T* find(const K& key) const
+	{
+		const T* result = lower_bound(key);
+		return result != NULL && !m_compare(key, *result) ? result : NULL;
+	}
+
+	template <typename K>
+	size_t count(const K& key) const { return find(key) != NULL ? 1 : 0; }
+
+	// frees the memory
+	void clear() { m_data.clear(); }
+
+	bool empty () const { return size() == 0; }
+	size_t size() const { return m_data.empty() ? 0 : m_data.size() - 1; }
+
+	// the elements in Eytzinger order, starting at 1
+	const T& operator[] (size_t index) const { return m_data[index]; }
+
+	void set_memory_label (MemLabelRef label) { m_data.set_memory_label(label); }
+
+private:
+
+	// in order walk of the implicit tree, returns the index of the next sorted element
+	size_t build(const T* sorted, size_t next, size_t k)
+	{
+		if (k < m_data.size())
+		{
+			next = build(sorted, next, 2 * k);
+			m_data[k] = sorted[next++];
+			next = build(sorted, next, 2 * k + 1);
+		}
+		return next;
+	}
+
+	dynamic_array<T, AlignOfType<T>::align, defaultLabel>	m_data;
+	Compare													m_compare;
+};